@@ -0,0 +1,715 @@
+// Layout and paint benchmarks over synthetic widget trees. Needs no window:
+// drawing goes to a software DrawBatch, recorded into a layer but never
+// rasterized.
+//
+//   uilib_bench [--max-nodes N] [--min-time SECONDS]
+
+#include "BoxConstraints.hpp"
+#include "DrawBatch.hpp"
+#include "FlatTree.hpp"
+#include "Markup.hpp"
+#include "PointerRouter.hpp"
+#include "RenderContext.hpp"
+#include "Widget.hpp"
+#include "WidgetArena.hpp"
+#include "widgets/Align.hpp"
+#include "widgets/Blob.hpp"
+#include "widgets/Button.hpp"
+#include "widgets/Constrained.hpp"
+#include "widgets/Flex.hpp"
+#include "widgets/ListView.hpp"
+#include "widgets/RepaintBoundary.hpp"
+#include "widgets/Position.hpp"
+#include "widgets/Static.hpp"
+#include "widgets/Text.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+static std::atomic<u64> alloc_count{0};
+
+// Kept out of line: once inlined, GCC pairs the free() with operator new and
+// reports a mismatched deallocation.
+[[gnu::noinline]] void* operator new(std::size_t n) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+using Clock = std::chrono::steady_clock;
+
+static f64 elapsed_ns(Clock::time_point since) {
+    return std::chrono::duration<f64, std::nano>(Clock::now() - since).count();
+}
+
+struct Tree {
+    std::unique_ptr<Widget> root;
+    std::vector<Blob*> leaves;
+    usize nodes = 0;
+};
+
+static usize count_nodes(Widget* w) {
+    usize n = 1;
+    for (usize i = 0; i < w->child_count(); i++) {
+        if (auto c = w->child_at(i)) n += count_nodes(c);
+    }
+    return n;
+}
+
+static Blob* leaf(Tree& t, u32 i) {
+    Blob* b = new Blob(8 + i % 5, 6 + i % 3, Color(i * 40, i * 90, i * 20, 255));
+    t.leaves.push_back(b);
+    return b;
+}
+
+// A Column of Rows, 32 leaves each.
+static Tree build_wide(usize n) {
+    Tree t;
+    Column* col = new Column;
+    for (usize i = 0; i * 33 < n; i++) {
+        Row* row = new Row;
+        for (u32 j = 0; j < 32; j++) row->add_child(leaf(t, j));
+        col->add_child(row);
+    }
+    t.root.reset(col);
+    return t;
+}
+
+// The wide tree with every Row behind a repaint boundary.
+static Tree build_boundaries(usize n) {
+    Tree t;
+    Column* col = new Column;
+    for (usize i = 0; i * 34 < n; i++) {
+        Row* row = new Row;
+        for (u32 j = 0; j < 32; j++) row->add_child(leaf(t, j));
+        col->add_child(new RepaintBoundary(row));
+    }
+    t.root.reset(col);
+    return t;
+}
+
+// A Column of chains alternating Align and ConstrainedBox, 256 levels deep.
+static Tree build_deep(usize n) {
+    static constexpr usize DEPTH = 256;
+    Tree t;
+    Column* col = new Column;
+    for (usize i = 0; i * DEPTH < n; i++) {
+        Widget* w = leaf(t, i);
+        for (usize d = 1; d < DEPTH; d++) {
+            if (d % 2) w = new Align(Align::TopLeft, w);
+            else w = new ConstrainedBox(BoxConstraints{ 0, 4000.f - d, 0, INFINITY }, w);
+        }
+        col->add_child(w);
+    }
+    t.root.reset(col);
+    return t;
+}
+
+// Rows and Columns nested four wide, inner ones and half of the leaves
+// wrapped in Expanded with varying flex factors.
+static Widget* build_flex_level(Tree& t, usize n, bool horizontal) {
+    Flex* f = horizontal ? static_cast<Flex*>(new Row) : static_cast<Flex*>(new Column);
+    if (n <= 8) {
+        for (u32 i = 0; i < 4; i++) {
+            if (i % 2) f->add_child(wi<Expanded>(leaf(t, i))->flex(1 + i % 3));
+            else f->add_child(leaf(t, i));
+        }
+        return f;
+    }
+    for (u32 i = 0; i < 4; i++) f->add_child(wi<Expanded>(build_flex_level(t, n / 4, !horizontal))->flex(1 + i % 2));
+    return f;
+}
+
+static Tree build_flex(usize n) {
+    Tree t;
+    t.root.reset(build_flex_level(t, n, true));
+    return t;
+}
+
+struct Phase {
+    const char* name;
+    std::vector<f64> ns_per_node; // one per size
+};
+
+struct Result {
+    std::vector<usize> nodes;
+    std::vector<f64> allocs_per_frame;
+    Phase phases[8] = {
+        { "layout", {} }, { "traverse", {} }, { "record", {} }, { "relayout1", {} },
+        { "flat layout", {} }, { "flat traverse", {} }, { "serial layout", {} }, { "clipped paint", {} },
+    };
+};
+
+static f64 median(std::vector<f64> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+// Least-squares slope of log(time) against log(nodes): 1 is linear. NAN when
+// a phase took no measurable time.
+static f64 scaling_slope(std::vector<usize> const& nodes, std::vector<f64> const& ns_per_node) {
+    usize n = nodes.size();
+    f64 sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (usize i = 0; i < n; i++) {
+        if (ns_per_node[i] <= 0) return NAN;
+        f64 x = std::log(f64(nodes[i]));
+        f64 y = std::log(ns_per_node[i] * nodes[i]);
+        sx += x, sy += y, sxx += x * x, sxy += x * y;
+    }
+    f64 d = n * sxx - sx * sx;
+    return d > 0 ? (n * sxy - sx * sy) / d : 1.0;
+}
+
+// relayout_at_root: the leaves' relayout boundary is the root, so changing
+// one lays the root out again over all of its cached children.
+static void run(const char* name, std::function<Tree(usize)> build, usize max_nodes, f64 min_time, bool relayout_at_root = false) {
+    static const Size WND = { 1600, 1200 };
+    Result res;
+    DrawBatch batch(DrawBatch::Software);
+    DrawBatch::Layer layer = batch.create_layer();
+    for (usize target = 1000; target <= max_nodes; target *= 10) {
+        Tree t = build(target);
+        t.nodes = count_nodes(t.root.get());
+        res.nodes.push_back(t.nodes);
+        t.root->layout(BoxConstraints::tight(WND));
+        FlatTree flat;
+        flat.compile(t.root.get());
+
+        std::vector<f64> layout, traverse, record, relayout, flat_layout, flat_traverse, serial_layout, clipped_paint, allocs;
+        f64 total = 0;
+        for (u32 frame = 0; frame < 3 || (total < min_time * 1e9 && frame < 1000); frame++) {
+            u64 allocs_before = alloc_count.load(std::memory_order_relaxed);
+            // a different root size each frame, so no layout is reused
+            auto start = Clock::now();
+            t.root->layout(BoxConstraints::tight(WND.w - frame % 2, WND.h));
+            layout.push_back(elapsed_ns(start));
+
+            RenderContext ctx;
+            start = Clock::now();
+            t.root->paint(ctx);
+            traverse.push_back(elapsed_ns(start));
+
+            ctx = RenderContext();
+            ctx.b = &batch;
+            start = Clock::now();
+            batch.begin_layer(layer);
+            t.root->paint(ctx);
+            batch.end_layer();
+            record.push_back(elapsed_ns(start) - traverse.back());
+            allocs.push_back(alloc_count.load(std::memory_order_relaxed) - allocs_before);
+
+            // one leaf changes size: only its relayout boundary should be redone
+            Blob* b = t.leaves[(frame * 7919) % t.leaves.size()];
+            start = Clock::now();
+            b->set_size({ 10.f + frame % 2, 7 });
+            t.root->flush_layout();
+            relayout.push_back(elapsed_ns(start));
+
+            start = Clock::now();
+            flat.layout(BoxConstraints::tight(WND.w - frame % 2, WND.h));
+            flat_layout.push_back(elapsed_ns(start));
+            ctx = RenderContext();
+            start = Clock::now();
+            flat.paint(ctx);
+            flat_traverse.push_back(elapsed_ns(start));
+
+            // the same full layout with the thread pool disabled
+            usize threshold = Widget::parallel_layout_threshold;
+            Widget::parallel_layout_threshold = SIZE_MAX;
+            start = Clock::now();
+            t.root->layout(BoxConstraints::tight(WND.w - 2 - frame % 2, WND.h));
+            serial_layout.push_back(elapsed_ns(start));
+            Widget::parallel_layout_threshold = threshold;
+
+            // traverse and record with the window as clip rect
+            ctx = RenderContext();
+            ctx.b = &batch;
+            ctx.clip = Rect::from_size(WND);
+            start = Clock::now();
+            batch.begin_layer(layer);
+            t.root->paint(ctx);
+            batch.end_layer();
+            clipped_paint.push_back(elapsed_ns(start));
+
+            total += layout.back() + traverse.back() + record.back() + relayout.back() + flat_layout.back() + flat_traverse.back() + serial_layout.back() + clipped_paint.back();
+        }
+        res.phases[0].ns_per_node.push_back(median(layout) / t.nodes);
+        res.phases[1].ns_per_node.push_back(median(traverse) / t.nodes);
+        res.phases[2].ns_per_node.push_back(std::max(0.0, median(record)) / t.nodes);
+        res.phases[3].ns_per_node.push_back(median(relayout) / t.nodes);
+        res.phases[4].ns_per_node.push_back(median(flat_layout) / t.nodes);
+        res.phases[5].ns_per_node.push_back(median(flat_traverse) / t.nodes);
+        res.phases[6].ns_per_node.push_back(median(serial_layout) / t.nodes);
+        res.phases[7].ns_per_node.push_back(median(clipped_paint) / t.nodes);
+        res.allocs_per_frame.push_back(median(allocs));
+    }
+    batch.destroy_layer(layer);
+
+    printf("\n%s\n%-10s", name, "nodes");
+    for (auto& p : res.phases) printf(" %14s", p.name);
+    printf(" %14s\n", "allocs/frame");
+    for (usize i = 0; i < res.nodes.size(); i++) {
+        printf("%-10zu", (size_t)res.nodes[i]);
+        for (auto& p : res.phases) printf(" %11.2f ns", p.ns_per_node[i]);
+        printf(" %14.0f\n", res.allocs_per_frame[i]);
+    }
+    if (res.nodes.size() < 2) return;
+    printf("%-10s", "slope");
+    for (auto& p : res.phases) {
+        f64 s = scaling_slope(res.nodes, p.ns_per_node);
+        if (std::isnan(s)) printf(" %14s", "-");
+        else printf(" %14.2f", s);
+    }
+    printf("\n");
+    // Full passes should be linear; cache misses alone push the slope a bit
+    // above 1 once the tree outgrows the caches. A single leaf relayout is
+    // expected to be sublinear, unless it relays out the root.
+    for (usize i = 0; i < 8; i++) {
+        f64 s = scaling_slope(res.nodes, res.phases[i].ns_per_node);
+        f64 limit = i == 3 && !relayout_at_root ? 1.0 : 1.3;
+        if (s > limit) printf("SUPERLINEAR: %s %s grows as n^%.2f (expected below n^%.1f)\n", name, res.phases[i].name, s, limit);
+    }
+}
+
+// Build, full layout and teardown of the same tree allocated from the heap and
+// from a WidgetArena, median of a few alternating runs.
+static void construction(const char* name, std::function<Tree(usize)> build, usize max_nodes) {
+    static const BoxConstraints WND = BoxConstraints::tight(1600, 1200);
+    printf("\n%s: construction\n%-10s %14s %14s %14s %14s %14s %14s\n", name, "nodes",
+        "heap build", "heap layout", "heap free", "arena build", "arena layout", "arena free");
+    for (usize target = 1000; target <= max_nodes; target *= 10) {
+        std::vector<f64> times[6];
+        usize nodes = 0;
+        for (u32 rep = 0; rep < 5; rep++) {
+            auto start = Clock::now();
+            Tree heap = build(target);
+            times[0].push_back(elapsed_ns(start));
+            nodes = count_nodes(heap.root.get());
+            start = Clock::now();
+            heap.root->layout(WND);
+            times[1].push_back(elapsed_ns(start));
+            start = Clock::now();
+            heap.root.reset();
+            times[2].push_back(elapsed_ns(start));
+
+            start = Clock::now();
+            auto arena = std::make_unique<WidgetArena>();
+            Tree t = arena->build([&] { return build(target); });
+            times[3].push_back(elapsed_ns(start));
+            start = Clock::now();
+            t.root->layout(WND);
+            times[4].push_back(elapsed_ns(start));
+            start = Clock::now();
+            t.root.reset();
+            arena.reset();
+            times[5].push_back(elapsed_ns(start));
+        }
+        printf("%-10zu", (size_t)nodes);
+        for (auto& v : times) printf(" %11.2f ns", median(v) / nodes);
+        printf("\n");
+    }
+}
+
+// Scrolling a ListView one step per frame: cost and memory should not depend
+// on the item count.
+static void list_view(usize max_items, f64 min_time) {
+    printf("\nListView scrolling\n%-10s %14s %14s %14s\n", "items", "frame", "allocs/frame", "widgets built");
+    DrawBatch batch(DrawBatch::Software);
+    DrawBatch::Layer layer = batch.create_layer();
+    for (usize n = 1000; n <= max_items * 10; n *= 10) {
+        usize built = 0;
+        Column root(wi<Expanded>(new ListView(n, [&](usize i, std::unique_ptr<Widget> recycled) -> std::unique_ptr<Widget> {
+            Size s = { 100, 14.f + i % 7 };
+            if (recycled) {
+                static_cast<Blob*>(recycled.get())->set_size(s);
+                return recycled;
+            }
+            built++;
+            return std::make_unique<Blob>(s, Color(i * 40, i * 90, i * 20, 255));
+        }))->flex(1));
+        ListView* list = static_cast<ListView*>(root.child_at(0)->child_at(0));
+        root.layout(BoxConstraints::tight(1600, 1200));
+        std::vector<f64> frames, allocs;
+        f64 total = 0;
+        for (u32 frame = 0; frame < 3 || (total < min_time * 1e9 && frame < 10000); frame++) {
+            u64 allocs_before = alloc_count.load(std::memory_order_relaxed);
+            auto start = Clock::now();
+            list->scroll_by(frame % 200 < 100 ? 53.f : -53.f);
+            root.flush_layout();
+            RenderContext ctx;
+            ctx.b = &batch;
+            batch.begin_layer(layer);
+            root.paint(ctx);
+            batch.end_layer();
+            frames.push_back(elapsed_ns(start));
+            allocs.push_back(alloc_count.load(std::memory_order_relaxed) - allocs_before);
+            total += frames.back();
+        }
+        printf("%-10zu %11.0f ns %14.0f %14zu\n", (size_t)n, median(frames), median(allocs), (size_t)built);
+    }
+    batch.destroy_layer(layer);
+}
+
+// A row that reports where it was painted.
+class ProbeRow : public Blob {
+    std::vector<std::pair<f32, f32>>* painted;
+public:
+    ProbeRow(Size s, std::vector<std::pair<f32, f32>>* painted) : Blob(s, Color(90, 90, 90, 255)), painted(painted) {}
+    void render(RenderContext& ctx) override {
+        painted->push_back({ ctx.pos.y + render_pos.y, render_size.h });
+        Blob::render(ctx);
+    }
+};
+
+// A ListView of millions of rows scrolled far down, where f32 content
+// offsets would be 8 px apart: every row must start where the one above it
+// ends, to within the rounding of positions in the viewport.
+static void list_view_far(usize items) {
+    printf("\nListView, %zu rows scrolled far down\n%-12s %12s %14s\n", (size_t)items, "offset", "rows", "worst gap");
+    std::vector<std::pair<f32, f32>> painted;
+    ListView list(items, [&](usize i, std::unique_ptr<Widget> recycled) -> std::unique_ptr<Widget> {
+        Size s = { 100, 20.f + i % 9 };
+        if (recycled) {
+            static_cast<Blob*>(recycled.get())->set_size(s);
+            return recycled;
+        }
+        return std::make_unique<ProbeRow>(s, &painted);
+    });
+    list.layout(BoxConstraints::tight(400, 1200));
+    f64 max = list.get_max_scroll_offset();
+    for (f64 offset : { max / 2 + 3, max - 1000.5, max }) {
+        list.set_scroll_offset(offset);
+        list.flush_layout();
+        painted.clear();
+        RenderContext ctx;
+        list.paint(ctx);
+        f32 worst = 0.f;
+        for (usize i = 1; i < painted.size(); i++) worst = std::max(worst, std::abs(painted[i].first - (painted[i - 1].first + painted[i - 1].second)));
+        printf("%-12.1f %12zu %11.4f px\n", list.get_scroll_offset(), (size_t)painted.size(), worst);
+        if (worst > 1e-3f) printf("MISPLACED: rows of a %zu item ListView at offset %.1f are up to %.2f px off\n", (size_t)items, list.get_scroll_offset(), worst);
+    }
+}
+
+// Hovering over a canvas of buttons: the cost of a mouse move should not
+// depend on how many targets there are.
+static void pointer(usize max_targets) {
+    printf("\nPointer hover over a canvas of buttons\n%-10s %14s %14s %14s\n", "targets", "index", "move p50", "move p99");
+    const Size wnd = { 1600, 1200 };
+    for (usize n = 1000; n <= max_targets / 10; n *= 10) {
+        // a square grid as large as the window
+        usize side = usize(std::ceil(std::sqrt(f64(n))));
+        f32 pitch = wnd.w / side;
+        WidgetList canvas;
+        for (usize i = 0; i < n; i++) {
+            canvas.add_child(new PositionBox((i % side) * pitch, (i / side) * pitch, new Button(pitch * 0.8f, pitch * 0.8f)));
+        }
+        canvas.layout(BoxConstraints::tight(wnd));
+        PointerRouter router;
+        router.set_viewport(wnd);
+        auto start = Clock::now();
+        router.update(&canvas);
+        f64 index = elapsed_ns(start);
+        std::vector<f64> moves;
+        u32 seed = 1;
+        for (u32 i = 0; i < 20000; i++) {
+            seed = seed * 1664525u + 1013904223u;
+            PointerEvent e;
+            e.pos = { f32((seed >> 8) % u32(wnd.w)), f32((seed >> 20) % u32(wnd.h)) };
+            start = Clock::now();
+            router.dispatch(e);
+            moves.push_back(elapsed_ns(start));
+        }
+        std::sort(moves.begin(), moves.end());
+        printf("%-10zu %11.2f ms %11.0f ns %11.0f ns\n", (size_t)n, index / 1e6, moves[moves.size() / 2], moves[moves.size() * 99 / 100]);
+    }
+}
+
+// The demo's CustomWidget built from dynamic widgets and as one Static leaf:
+// full relayout and paint of a column of copies.
+class DynamicHud : public ConstrainedBox {
+public:
+    DynamicHud() : ConstrainedBox(BoxConstraints { 150, INFINITY, 0, INFINITY }, wi<Row>(
+        wi<Blob>(40, 40, 0xff0000ff),
+        wi<ConstrainedBox>(BoxConstraints::tight_h(40), wi<Column>(
+            wi<Blob>(100, 15, 0xff0000ff),
+            wi<Blob>(90, 15, 0xff0000ff)
+        )->set_main_axis_alignment(Flex::MainAxisSpaceAround))
+    )->set_main_axis_size(Flex::MainAxisMin)->set_main_axis_alignment(Flex::MainAxisSpaceBetween)) {}
+};
+using StaticHud = Static<StaticConstrained<BoxConstraints{150, INFINITY, 0, INFINITY},
+    StaticFlex<Axis::Horizontal, StaticFlexOptions{Flex::MainAxisMin, Flex::MainAxisSpaceBetween},
+        StaticBlob<40, 40, 0xff0000ff>,
+        StaticConstrained<BoxConstraints{0, INFINITY, 40, 40},
+            StaticFlex<Axis::Vertical, StaticFlexOptions{.main_axis_alignment = Flex::MainAxisSpaceAround},
+                StaticBlob<100, 15, 0xff0000ff>,
+                StaticBlob<90, 15, 0xff0000ff>>>>>>;
+
+static void static_composition(f64 min_time) {
+    printf("\nStatic composition, 1000 HUDs of 7 widgets\n%-10s %14s %14s %14s\n", "", "layout/hud", "paint/hud", "widgets");
+    const usize n = 1000;
+    DrawBatch batch(DrawBatch::Deferred);
+    FramePacket packet;
+    auto measure = [&](const char* name, std::function<Widget*()> make) {
+        Column root;
+        for (usize i = 0; i < n; i++) root.add_child(make());
+        std::vector<f64> layouts, paints;
+        f64 total = 0;
+        for (u32 frame = 0; frame < 3 || (total < min_time * 1e9 && frame < 10000); frame++) {
+            // a different width every frame relays out every HUD
+            auto start = Clock::now();
+            root.layout(BoxConstraints::tight(1600.f - frame % 2, 1200));
+            layouts.push_back(elapsed_ns(start));
+            start = Clock::now();
+            RenderContext ctx;
+            ctx.b = &batch;
+            root.paint(ctx);
+            paints.push_back(elapsed_ns(start));
+            total += layouts.back() + paints.back();
+            batch.submit();
+            batch.take_frame(packet);
+        }
+        printf("%-10s %11.1f ns %11.1f ns %14zu\n", name, median(layouts) / n, median(paints) / n, (size_t)count_nodes(&root) - 1);
+    };
+    measure("dynamic", [] { return new DynamicHud; });
+    measure("Static", [] { return new StaticHud; });
+}
+
+// Startup cost of a generated screen of Rows of Blobs: parsing the text,
+// building widgets from it, and viewing plus building the compiled image.
+static void markup(usize max_nodes) {
+    printf("\nMarkup screens\n%-10s %14s %14s %14s %14s\n", "nodes", "parse", "build", "compiled", "image");
+    for (usize n = 1000; n <= max_nodes / 10; n *= 10) {
+        std::string text = "<Widget \"Cell\"><ConstrainedBox tight_h(12)><Blob 8x6 0xff0000ff /></ConstrainedBox></Widget>\n<Column main_axis_size=min>\n";
+        usize nodes = 1;
+        for (usize row = 0; nodes < n; row++) {
+            text += "  <Row main_axis_alignment=space_between>\n";
+            nodes++;
+            for (u32 i = 0; i < 32; i++) {
+                if (i % 8 == 0) text += "    <Widget \"Cell\" />\n", nodes += 2;
+                else text += "    <Blob " + std::to_string(8 + i % 5) + "x" + std::to_string(6 + i % 3) + " 0x" + std::to_string(10 + row % 80) + "2040ff />\n", nodes++;
+            }
+            text += "  </Row>\n";
+        }
+        text += "</Column>\n";
+        auto start = Clock::now();
+        MarkupDocument doc;
+        std::string error;
+        if (!parse_markup(text, doc, &error)) {
+            printf("%s\n", error.c_str());
+            return;
+        }
+        f64 parse = elapsed_ns(start);
+        start = Clock::now();
+        auto root = build_markup(doc);
+        f64 build = elapsed_ns(start);
+        std::vector<u8> image = compile_markup(doc);
+        root.reset();
+        start = Clock::now();
+        MarkupDocument compiled;
+        read_compiled_markup(image, compiled);
+        root = build_markup(compiled);
+        f64 load = elapsed_ns(start);
+        printf("%-10zu %11.2f ms %11.2f ms %11.2f ms %11zu kB\n", (size_t)count_nodes(root.get()), parse / 1e6, build / 1e6, load / 1e6, (size_t)image.size() / 1024);
+    }
+}
+
+// Recording a heatmap-sized batch of rectangles one call at a time, as one
+// span, and written by the caller into claimed room. Deferred batches only
+// record, so this is the CPU side alone.
+static void rectangles(f64 min_time) {
+    printf("\nRectangle recording\n%-22s %14s\n", "", "rects/s");
+    const usize n = 250000;
+    std::vector<DrawBatch::RectCmd> cmds(n);
+    for (usize i = 0; i < n; i++) {
+        f32 x = f32(i % 500) * 3.2f, y = f32(i / 500) * 2.4f;
+        cmds[i] = { x, x + 3.2f, y, y + 2.4f, 0, Color(i * 40, i * 90, i * 20, 255) };
+    }
+    DrawBatch batch(DrawBatch::Deferred);
+    FramePacket packet;
+    auto measure = [&](const char* name, std::function<void()> record) {
+        std::vector<f64> frames;
+        f64 total = 0;
+        for (u32 frame = 0; frame < 3 || (total < min_time * 1e9 && frame < 1000); frame++) {
+            auto start = Clock::now();
+            record();
+            frames.push_back(elapsed_ns(start));
+            total += frames.back();
+            batch.submit();
+            batch.take_frame(packet);
+        }
+        printf("%-22s %12.1f M\n", name, n / median(frames) * 1e3);
+    };
+    measure("draw_rectangle", [&] {
+        for (auto const& c : cmds) batch.draw_rectangle(c.x1, c.x2, c.y1, c.y2, c.z, c.c);
+    });
+    measure("draw_rectangles", [&] { batch.draw_rectangles(cmds); });
+    // against a clip rect that keeps an eighth of them: both drop the others
+    const Rect clip = { 400.f, 150.f, 1200.f, 450.f };
+    measure("clipped draw_rectangle", [&] {
+        for (auto const& c : cmds) batch.draw_rectangle(c.x1, c.x2, c.y1, c.y2, c.z, c.c, clip);
+    });
+    measure("clipped rectangles", [&] { batch.draw_rectangles(cmds, clip); });
+    // one instance each, like a plain rectangle
+    measure("draw_rounded_rectangle", [&] {
+        for (auto const& c : cmds) batch.draw_rounded_rectangle(c.x1, c.x2, c.y1, c.y2, c.z, c.c, 1.f);
+    });
+    measure("draw_shadow", [&] {
+        for (auto const& c : cmds) batch.draw_shadow(c.x1, c.x2, c.y1, c.y2, c.z, c.c, 1.f, 4.f);
+    });
+    measure("claim", [&] {
+        rect_instance_t* r = batch.claim(n);
+        for (usize i = 0; i < n; i++) r[i] = { i16(i % 500 * 3), i16(i / 500 * 2), 3, 2, 0, cmds[i].c };
+    });
+}
+
+// A panel of numeric labels, a quarter of which get a new value every
+// frame: values from a small set hit the run cache, unique ones are shaped
+// every time. Times are per updated label; glyphs are drawn into the batch
+// as textured instances next to the rectangles.
+static void text_labels(f64 min_time) {
+    printf("\nNumeric labels, 2000 in 40 Rows, 500 updated per frame\n%-10s %14s %14s %14s %14s\n", "values", "set_text", "layout", "paint", "instances");
+    const usize rows = 40, per_row = 50, n = rows * per_row;
+    DrawBatch batch(DrawBatch::Deferred);
+    FramePacket packet;
+    GlyphAtlas atlas;
+    auto measure = [&](const char* name, usize distinct) {
+        Column root;
+        std::vector<Text*> labels;
+        for (usize r = 0; r < rows; r++) {
+            Row* row = new Row;
+            for (usize i = 0; i < per_row; i++) {
+                labels.push_back(new Text("0.00", 12.f));
+                row->add_child(labels.back());
+            }
+            root.add_child(row);
+        }
+        root.layout(BoxConstraints::tight(2400, 1200));
+        std::vector<f64> sets, layouts, paints;
+        usize instances = 0;
+        f64 total = 0;
+        char buf[32];
+        for (u32 frame = 0; frame < 3 || (total < min_time * 1e9 && frame < 10000); frame++) {
+            auto start = Clock::now();
+            for (usize i = frame % 4; i < n; i += 4) {
+                usize v = (i * 7919 + frame * 104729) % distinct;
+                snprintf(buf, sizeof(buf), "%zu.%02zu", size_t(v / 100), size_t(v % 100));
+                labels[i]->set_text(buf);
+            }
+            sets.push_back(elapsed_ns(start));
+            start = Clock::now();
+            root.flush_layout();
+            layouts.push_back(elapsed_ns(start));
+            start = Clock::now();
+            atlas.begin_frame();
+            RenderContext ctx;
+            ctx.b = &batch;
+            ctx.glyphs = &atlas;
+            root.paint(ctx);
+            atlas.upload(batch);
+            paints.push_back(elapsed_ns(start));
+            total += sets.back() + layouts.back() + paints.back();
+            batch.submit();
+            batch.take_frame(packet);
+            instances = packet.rects.size();
+        }
+        usize updated = n / 4;
+        printf("%-10s %11.1f ns %11.1f ns %11.1f ns %14zu\n", name, median(sets) / updated, median(layouts) / updated, median(paints) / updated, (size_t)instances);
+    };
+    measure("1000", 1000);
+    measure("unique", ~usize(0));
+}
+
+// A monitoring wall: 16x9 tiles, each a repaint boundary, in a 1920x1080
+// software batch, with a few tiles changing colour every frame. Times are
+// per frame, from clear to the rasterized frame; partial redraw only clears
+// and rasterizes what changed.
+static void wall(f64 min_time) {
+    printf("\nMonitoring wall, 144 tiles at 1920x1080, software rasterizer\n%-22s %14s %14s\n", "", "frame", "redrawn");
+    const usize cols = 16, rows = 9;
+    auto measure = [&](const char* name, usize changed, bool partial) {
+        DrawBatch batch(DrawBatch::Software);
+        batch.update_wnd_size({1920.f, 1080.f});
+        batch.set_partial_redraw(partial);
+        Column root;
+        std::vector<Blob*> tiles;
+        for (usize r = 0; r < rows; r++) {
+            Row* row = new Row;
+            for (usize c = 0; c < cols; c++) {
+                tiles.push_back(new Blob({120.f, 120.f}, Color(40, 40 + c * 10, 40 + r * 20, 255)));
+                row->add_child(new RepaintBoundary(tiles.back()));
+            }
+            root.add_child(row);
+        }
+        root.layout(BoxConstraints::tight(1920, 1080));
+        DrawBatch::Layer layer = batch.create_layer();
+        std::vector<f64> frames;
+        f32 redrawn = 0.f;
+        f64 total = 0;
+        for (u32 frame = 0; frame < 3 || (total < min_time * 1e9 && frame < 1000); frame++) {
+            for (usize i = 0; i < changed; i++) tiles[(frame * 37 + i * 53) % tiles.size()]->set_color(Color(frame * 13 + i, 120, 60, 255));
+            auto start = Clock::now();
+            if (root.get_needs_paint()) {
+                batch.begin_layer(layer);
+                RenderContext ctx;
+                ctx.b = &batch;
+                root.paint(ctx);
+                batch.end_layer();
+            } else {
+                root.flush_paint();
+            }
+            batch.clear(Color(255, 255, 255, 255));
+            batch.draw_layer(layer);
+            batch.submit();
+            frames.push_back(elapsed_ns(start));
+            total += frames.back();
+            redrawn = batch.last_frame_stats().redrawn_fraction;
+        }
+        printf("%-22s %11.1f us %13.1f%%\n", name, median(frames) / 1e3, redrawn * 100.f);
+    };
+    measure("1 tile, full redraw", 1, false);
+    measure("1 tile, partial", 1, true);
+    measure("4 tiles, partial", 4, true);
+}
+
+int main(int argc, char** argv) {
+    usize max_nodes = 1000000;
+    f64 min_time = 0.25;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--max-nodes")) max_nodes = strtoull(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--min-time")) min_time = atof(argv[i + 1]);
+        else {
+            fprintf(stderr, "usage: %s [--max-nodes N] [--min-time SECONDS]\n", argv[0]);
+            return 1;
+        }
+    }
+    printf("per-node median frame times; record = vertex generation (paint minus traversal)\n");
+    printf("layout uses %u pool workers from %zu widgets; serial layout uses none\n", ThreadPool::global().worker_count(), (size_t)Widget::parallel_layout_threshold);
+    // the Rows get loose constraints from the Column
+    run("wide Column of Rows", build_wide, max_nodes, min_time, true);
+    run("wide Column of repaint boundaries", build_boundaries, max_nodes, min_time, true);
+    run("deep Align/ConstrainedBox chains", build_deep, max_nodes, min_time);
+    run("nested Flex with Expanded", build_flex, max_nodes, min_time);
+    construction("wide Column of Rows", build_wide, max_nodes);
+    construction("nested Flex with Expanded", build_flex, max_nodes);
+    list_view(max_nodes, min_time);
+    list_view_far(5 * max_nodes);
+    pointer(max_nodes);
+    static_composition(min_time);
+    markup(max_nodes);
+    rectangles(min_time);
+    text_labels(min_time);
+    wall(min_time);
+    return 0;
+}
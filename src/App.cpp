@@ -1,99 +1,330 @@
 #include "App.hpp"
 #include "BoxConstraints.hpp"
 #include "DrawBatch.hpp"
+#include "Profiler.hpp"
+#include "RenderThread.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_events.h>
 #include <SDL2/SDL_video.h>
 #include <cstdlib>
 #include <GL/glew.h>
-#include <ctime>
+#include <mutex>
+#include <vector>
+
+// Longest OnDemand sleeps between two looks at the widget tree.
+static constexpr int IDLE_TIMEOUT_MS = 500;
+// Pixels scrolled per notch of the mouse wheel.
+static constexpr f32 WHEEL_STEP = 48.f;
 
 struct AppState {
     SDL_Window *w;
     SDL_GLContext ctx;
+    // With a window, b records Deferred frames that the render thread draws
+    // with gpu, so the next frame is built while this one is drawn.
     DrawBatch *b;
+    DrawBatch *gpu = nullptr;
+    RenderThread *renderer = nullptr;
+    FramePacket packet;
+    DrawBatch::Layer root_layer;
+    App::RenderMode mode = App::Continuous;
+    Uint32 wake_event = 0;
+    bool redraw = true;
+    u32 animations = 0;
+    std::mutex posted_mutex;
+    std::vector<std::function<void()>> posted;
+    FrameScheduler scheduler;
+    PointerRouter pointer;
+    std::vector<Widget*> relaid;
+    GlyphAtlas glyphs;
 };
 
+static PointerEvent::Button pointer_button(Uint8 b) {
+    switch (b) {
+    case SDL_BUTTON_LEFT: return PointerEvent::Left;
+    case SDL_BUTTON_MIDDLE: return PointerEvent::Middle;
+    case SDL_BUTTON_RIGHT: return PointerEvent::Right;
+    }
+    return PointerEvent::NoButton;
+}
+
 void App::update_size(Size s) {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
     wnd_size = s;
-    reinterpret_cast<AppState*>(app_state)->b->update_wnd_size(s);
-    root->calculate_layout(BoxConstraints::tight(wnd_size));
-    glViewport(0, 0, s.w, s.h);
+    state->b->update_wnd_size(s);
+    root->layout(BoxConstraints::tight(wnd_size));
+    state->pointer.set_viewport(s);
+    state->pointer.update(root.get());
+    state->pointer.refresh_hover();
+}
+
+static void mark_all_needs_paint(Widget* w) {
+    w->mark_needs_paint();
+    for (usize i = 0; i < w->child_count(); i++) {
+        if (auto c = w->child_at(i)) mark_all_needs_paint(c);
+    }
 }
 
 void App::render() {
-    glClearColor(1, 1, 1, 1);
-    glClearDepth(1);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    RenderContext context;
-    context.b = reinterpret_cast<AppState*>(app_state)->b;
-    root->render(context);
-    context.b->submit();
+    AppState *state = reinterpret_cast<AppState*>(app_state);
+    auto paint_root = [&] {
+        state->b->begin_layer(state->root_layer);
+        RenderContext context;
+        context.b = state->b;
+        context.clip = Rect::from_size(wnd_size);
+        context.glyphs = &state->glyphs;
+        root->paint(context);
+        state->b->end_layer();
+    };
+    state->glyphs.begin_frame();
+    u64 glyph_generation = state->glyphs.generation();
+    // The root is drawn into a retained layer like any repaint boundary: when
+    // nothing was marked, the previous frame's geometry is drawn again as is.
+    if (root->get_needs_paint()) {
+        PROFILE_ZONE("paint");
+        paint_root();
+    } else {
+        PROFILE_ZONE("paint");
+        root->flush_paint();
+    }
+    // Layers that were not recorded again may draw glyphs evicted meanwhile:
+    // record everything again. What this pass draws is all that is left on
+    // screen, so it starts a new frame for the atlas; glyphs it drew are never
+    // evicted during it. Instances that did not change may now sample other
+    // glyphs, so none of the previous frame can be kept.
+    if (state->glyphs.generation() != glyph_generation) {
+        PROFILE_ZONE("repaint evicted glyphs");
+        state->glyphs.begin_frame();
+        mark_all_needs_paint(root.get());
+        paint_root();
+        state->b->damage(Rect::everything());
+    }
+    state->glyphs.upload(*state->b);
+    state->b->clear(Color(255, 255, 255, 255));
+    state->b->draw_layer(state->root_layer);
+    state->b->submit();
+}
+
+void App::render_frame() {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    {
+        PROFILE_ZONE("layout");
+        state->relaid.clear();
+        root->flush_layout(&state->relaid);
+    }
+    // only what was laid out again can have moved
+    for (Widget* w : state->relaid) state->pointer.update(w);
+    if (!state->relaid.empty()) state->pointer.refresh_hover();
+    render();
+}
+
+Widget* App::widget_at(Position p) const {
+    return reinterpret_cast<AppState*>(app_state)->pointer.hit_test(p);
 }
 
-App::App(const char* wnd_name, Size wnd_size, std::unique_ptr<Widget> &&root) : root(std::move(root)), wnd_size(wnd_size) {
-    SDL_Init(SDL_INIT_VIDEO);
+DrawBatch::Stats const& App::last_frame_stats() const {
+    return reinterpret_cast<AppState*>(app_state)->b->last_frame_stats();
+}
+
+bool App::save_frame(const char* path) {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    if (!state->renderer) return state->b->write_ppm(path);
+    bool ok = false;
+    state->renderer->call([&] { ok = state->gpu->write_ppm(path); });
+    return ok;
+}
+
+App::App(const char* wnd_name, Size wnd_size, std::unique_ptr<Widget> &&root, DrawBatch::Backend backend) : root(std::move(root)), wnd_size(wnd_size) {
     AppState *state = new AppState;
     app_state = state;
-    state->w = SDL_CreateWindow(wnd_name, 0, 0, wnd_size.w, wnd_size.h, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
-    state->ctx = SDL_GL_CreateContext(state->w);
-    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetSwapInterval(1);
-    glewInit();
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquation(GL_ADD);
-    state->b = new DrawBatch;
+    state->w = nullptr;
+    state->ctx = nullptr;
+    if (backend == DrawBatch::OpenGL) {
+        SDL_Init(SDL_INIT_VIDEO);
+        state->w = SDL_CreateWindow(wnd_name, 0, 0, wnd_size.w, wnd_size.h, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+        state->ctx = SDL_GL_CreateContext(state->w);
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+        SDL_GL_SetSwapInterval(1);
+        glewInit();
+        state->wake_event = SDL_RegisterEvents(1);
+        state->gpu = new DrawBatch(DrawBatch::OpenGL);
+        state->b = new DrawBatch(DrawBatch::Deferred);
+        state->renderer = new RenderThread(state->w, state->ctx, state->gpu, &state->scheduler);
+    } else {
+        state->b = new DrawBatch(backend);
+    }
+    state->root_layer = state->b->create_layer();
     update_size(wnd_size);
 }
 
 App::~App() {
+#ifdef UILIB_PROFILE
+    if (const char* path = getenv("UILIB_TRACE")) Profiler::write_chrome_trace(path);
+#endif
     AppState* s = reinterpret_cast<AppState*>(app_state);
+    root.reset();
+    // draws what was handed over and gives the context back to this thread
+    delete s->renderer;
+    delete s->gpu;
     delete s->b;
-    SDL_GL_DeleteContext(s->ctx);
-    SDL_DestroyWindow(s->w);
+    if (s->w) {
+        SDL_GL_DeleteContext(s->ctx);
+        SDL_DestroyWindow(s->w);
+        SDL_Quit();
+    }
     delete s;
-    SDL_Quit();
 }
 
-void App::run() {
+void App::set_render_mode(RenderMode mode) {
+    reinterpret_cast<AppState*>(app_state)->mode = mode;
+}
+
+App::VSync App::set_vsync(VSync vsync) {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    if (!state->renderer) return VSyncOff;
+    // the swap interval belongs to the context, current on the render thread
+    state->renderer->call([&] {
+        if (vsync == VSyncAdaptive) {
+            if (SDL_GL_SetSwapInterval(-1) == 0) return;
+            vsync = VSyncOn;
+        }
+        SDL_GL_SetSwapInterval(vsync == VSyncOn ? 1 : 0);
+    });
+    return vsync;
+}
+
+void App::set_target_rate(f64 hz) {
+    reinterpret_cast<AppState*>(app_state)->scheduler.set_target_rate(hz);
+}
+
+FrameScheduler::Stats App::frame_timing() const {
+    return reinterpret_cast<AppState*>(app_state)->scheduler.stats();
+}
+
+void App::set_partial_redraw(bool enable) {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    state->b->set_partial_redraw(enable);
+    if (state->renderer) state->renderer->call([&] { state->gpu->set_partial_redraw(enable); });
+}
+
+void App::request_frame() {
+    reinterpret_cast<AppState*>(app_state)->redraw = true;
+}
+
+void App::begin_animation() {
+    reinterpret_cast<AppState*>(app_state)->animations++;
+}
+
+void App::end_animation() {
+    reinterpret_cast<AppState*>(app_state)->animations--;
+}
+
+void App::wake() {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    if (!state->w) return;
+    SDL_Event e{};
+    e.type = state->wake_event;
+    SDL_PushEvent(&e);
+}
+
+void App::post(std::function<void()> f) {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    {
+        std::lock_guard lock(state->posted_mutex);
+        state->posted.push_back(std::move(f));
+    }
+    wake();
+}
+
+bool App::needs_frame() const {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    return state->mode == Continuous || state->redraw || state->animations > 0 || root->is_dirty();
+}
+
+bool App::process_events(bool wait) {
+    PROFILE_ZONE("events");
+    AppState* state = reinterpret_cast<AppState*>(app_state);
     SDL_Event e;
     bool is_running = true;
-    const f64 fps = 60.0;
-    const f64 target_frame_time = 1.0 / fps;
-    while (is_running) {
-        timespec now;
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        f64 frame_start_time = now.tv_sec + now.tv_nsec * 0.000000001;
-
-        while (SDL_PollEvent(&e)) {
-            switch (e.type) {
-            case SDL_QUIT:
-                is_running = false;
-                break;
-            case SDL_WINDOWEVENT:
-                switch (e.window.event) {
-                    case SDL_WINDOWEVENT_RESIZED:
-                        update_size(Size(e.window.data1, e.window.data2));
-                        break;
-                }
-                break;
+    bool have = wait ? SDL_WaitEventTimeout(&e, IDLE_TIMEOUT_MS) : SDL_PollEvent(&e);
+    for (; have; have = SDL_PollEvent(&e)) {
+        PointerEvent pe;
+        switch (e.type) {
+        case SDL_QUIT:
+            is_running = false;
+            break;
+        case SDL_MOUSEMOTION:
+            pe.pos = Position(e.motion.x, e.motion.y);
+            state->pointer.dispatch(pe);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            pe.type = e.type == SDL_MOUSEBUTTONDOWN ? PointerEvent::Press : PointerEvent::Release;
+            pe.button = pointer_button(e.button.button);
+            pe.pos = Position(e.button.x, e.button.y);
+            state->pointer.dispatch(pe);
+            break;
+        case SDL_MOUSEWHEEL: {
+            int x, y;
+            SDL_GetMouseState(&x, &y);
+            f32 flip = e.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -1.f : 1.f;
+            pe.type = PointerEvent::Wheel;
+            pe.pos = Position(x, y);
+            // positive wheel y scrolls up, towards the start of the content
+            pe.scroll = Position(e.wheel.x, -e.wheel.y) * (flip * WHEEL_STEP);
+            state->pointer.dispatch(pe);
+            break;
+        }
+        case SDL_WINDOWEVENT:
+            switch (e.window.event) {
+                case SDL_WINDOWEVENT_RESIZED:
+                    update_size(Size(e.window.data1, e.window.data2));
+                    break;
+                case SDL_WINDOWEVENT_EXPOSED:
+                    state->redraw = true;
+                    break;
+                case SDL_WINDOWEVENT_LEAVE:
+                    state->pointer.leave();
+                    break;
             }
+            break;
         }
-        render();
-        AppState *state = reinterpret_cast<AppState*>(app_state);
-        SDL_GL_SwapWindow(state->w);
-
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        f64 frame_end_time = now.tv_sec + now.tv_nsec * 0.000000001;
-        f64 frame_elapsed_time = frame_end_time - frame_start_time;
-        f64 remaining_seconds = target_frame_time - frame_elapsed_time;
-        if (remaining_seconds > 0.0) {
-            timespec ts;
-            ts.tv_sec = (int)remaining_seconds;
-            ts.tv_nsec = (int)((remaining_seconds - ts.tv_sec - 0.001) * 1000000000);
-            nanosleep(&ts, 0);
+    }
+    std::vector<std::function<void()>> posted;
+    {
+        std::lock_guard lock(state->posted_mutex);
+        posted.swap(state->posted);
+    }
+    for (auto& f : posted) f();
+    return is_running;
+}
+
+void App::run() {
+    AppState* state = reinterpret_cast<AppState*>(app_state);
+    if (!state->w) {
+        render_frame();
+        return;
+    }
+    bool is_running = true;
+    while (is_running) {
+        // With a frame due, sleep until it should start and take the events
+        // after that, so they are as fresh as possible. Otherwise sleep in the
+        // event queue; a frame woken from there starts right away.
+        bool idle = !needs_frame();
+        if (idle) state->scheduler.idle();
+        else state->scheduler.wait_for_next_frame();
+        is_running = process_events(idle);
+        // nothing can look different: keep the presented frame
+        if (!needs_frame()) continue;
+        if (idle) state->scheduler.wait_for_next_frame();
+        PROFILE_ZONE("frame");
+        state->redraw = false;
+        render_frame();
+        state->scheduler.work_done();
+        {
+            // blocks only while the render thread is two frames behind
+            PROFILE_ZONE("hand over");
+            state->b->take_frame(state->packet);
+            state->renderer->present(state->packet);
         }
     }
 }
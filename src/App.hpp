@@ -1,20 +1,75 @@
 #ifndef APP_H_
 #define APP_H_
 
+#include "DrawBatch.hpp"
+#include "FrameScheduler.hpp"
+#include "PointerRouter.hpp"
 #include "Widget.hpp"
+#include <functional>
 #include <memory>
 
 class App {
     void update_size(Size s);
     void render();
+    // Returns false once the window was closed. With wait set, blocks until
+    // an event arrives or the idle timeout passes.
+    bool process_events(bool wait);
+    bool needs_frame() const;
     void* app_state = nullptr;
 public:
-    App(const char* wnd_name, Size wnd_size, std::unique_ptr<Widget> &&root);
-    App(const char* wnd_name, Size wnd_size, Widget *root) : App(wnd_name, wnd_size, std::unique_ptr<Widget>(root)) {}
+    enum RenderMode {
+        // Renders and swaps at a fixed rate whether or not anything changed.
+        Continuous,
+        // Sleeps in the event queue and only renders when the output can have
+        // changed: a widget is dirty, an animation runs, the window needs
+        // redrawing or a frame was requested.
+        OnDemand,
+    };
+    enum VSync {
+        VSyncOff,
+        VSyncOn,
+        // Waits for vblank, but swaps right away when a frame is late instead
+        // of tearing a whole refresh off the frame rate. Needs driver support.
+        VSyncAdaptive,
+    };
+    // The Software backend opens no window: run() renders a single frame,
+    // which can then be saved with save_frame.
+    App(const char* wnd_name, Size wnd_size, std::unique_ptr<Widget> &&root, DrawBatch::Backend backend = DrawBatch::OpenGL);
+    App(const char* wnd_name, Size wnd_size, Widget *root, DrawBatch::Backend backend = DrawBatch::OpenGL) : App(wnd_name, wnd_size, std::unique_ptr<Widget>(root), backend) {}
     ~App();
     std::unique_ptr<Widget> root;
     Size wnd_size;
     void run();
+    // Lays out and records a frame. With a window, run() then hands it to
+    // the render thread, which owns the GL context.
+    void render_frame();
+    bool save_frame(const char* path);
+    void set_render_mode(RenderMode mode);
+    // Returns the mode in effect: adaptive falls back to on when unsupported.
+    VSync set_vsync(VSync vsync);
+    // Frames per second App::run paces to; 0 leaves pacing to vsync.
+    void set_target_rate(f64 hz);
+    // Only redraws the parts of the window that changed since the previous
+    // frame (the default), or every frame whole; see
+    // DrawBatch::set_partial_redraw.
+    void set_partial_redraw(bool enable);
+    // Frame intervals and work times of recent frames.
+    FrameScheduler::Stats frame_timing() const;
+    // Renders the next frame even if no widget is dirty.
+    void request_frame();
+    // While any animation is running, OnDemand renders every frame like
+    // Continuous does.
+    void begin_animation();
+    void end_animation();
+    // Thread-safe: wakes the loop from another thread.
+    void wake();
+    // Thread-safe: runs f on the loop's thread before its next frame.
+    void post(std::function<void()> f);
+    // The pointer target that would get a press at p.
+    Widget* widget_at(Position p) const;
+    // Counters of the last rendered frame, including the culled widgets and
+    // the share of the window drawn again.
+    DrawBatch::Stats const& last_frame_stats() const;
 };
 
 #endif // APP_H_
@@ -104,6 +104,7 @@ struct BoxConstraints {
             min_height, std::max(this->min_height, max_height),
         };
     }
+    bool operator==(BoxConstraints const&) const = default;
     BoxConstraints operator*(f32 factor) const { return { min_width * factor, max_width * factor, min_height * factor, max_height * factor }; }
     BoxConstraints operator/(f32 factor) const { return { min_width / factor, max_width / factor, min_height / factor, max_height / factor }; }
     BoxConstraints operator/(i32 factor) const { return { min_width / factor, max_width / factor, min_height / factor, max_height / factor }; }
@@ -1,7 +1,17 @@
 #include "DrawBatch.hpp"
+#include "Profiler.hpp"
+#include "SoftwareRasterizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
 #include <iostream>
+#include <cstddef>
 #include <vector>
 #include <GL/glew.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 struct Shader {
     u32 program_id;
@@ -45,51 +55,780 @@ void Shader::init(const char* vtx, i32 vtx_s, const char* fgr, i32 fgr_s) {
     uniform_loc = glGetUniformLocation(program_id, "the_matrix");
 }
 
+// Every rectangle is one instance: the unit quad corner is scaled by the
+// instance size and offset by its position. Textured instances map their
+// pixels one to one onto atlas texels; shapes get the offset from the center
+// of the quad and their parameters unpacked (see rect_instance_t).
 const char vtx_shdr[] = R"shdr(#version 460
-in vec3 in_pos;
-in vec4 in_col;
+layout(location = 0) in vec2 in_corner;
+layout(location = 1) in ivec4 in_rect;
+layout(location = 2) in float in_z;
+layout(location = 3) in vec4 in_col;
+layout(location = 4) in uvec2 in_uv;
+layout(location = 5) in ivec4 in_clip;
 uniform mat4 the_matrix;
 out vec4 frag_col;
+out vec2 frag_uv;
+out vec2 frag_pos;
+flat out uint frag_kind;
+flat out vec4 frag_shape;
+flat out float frag_blur;
+flat out vec4 frag_clip;
 void main() {
-    gl_Position = the_matrix * vec4(in_pos, 1.0);
+    vec2 size = vec2(in_rect.zw);
+    vec2 pos = vec2(in_rect.xy) + in_corner * size;
+    gl_Position = the_matrix * vec4(pos, in_z, 1.0);
     frag_col = in_col;
+    frag_pos = pos;
+    frag_clip = vec4(in_clip);
+    frag_shape = vec4(0.0);
+    frag_blur = 0.0;
+    if ((in_uv.x & 0x8000u) != 0u) {
+        frag_kind = 2u;
+        frag_uv = (in_corner - 0.5) * size;
+        frag_blur = float(in_uv.y >> 8);
+        frag_shape = vec4(max(abs(size) * 0.5 - frag_blur, 0.0), float(in_uv.x & 0x7fffu) * 0.25, float(in_uv.y & 0xffu) * 0.25);
+    } else {
+        frag_kind = (in_uv.x | in_uv.y) != 0u ? 1u : 0u;
+        frag_uv = vec2(in_uv) + in_corner * size;
+    }
 })shdr";
+// Shapes take their coverage from the signed distance to a rounded rectangle
+// (frag_shape: half size, radius, border width). Coverage is quantized to 8
+// bits like atlas texels, and the coverage-scaled alpha is rounded like the
+// software rasterizer's; fragments left transparent or outside of the clip
+// box write no depth.
 const char fgr_shdr[] = R"shdr(#version 460
 in vec4 frag_col;
+in vec2 frag_uv;
+in vec2 frag_pos;
+flat in uint frag_kind;
+flat in vec4 frag_shape;
+flat in float frag_blur;
+flat in vec4 frag_clip;
+uniform sampler2D atlas;
 out vec4 output_color;
+float coverage() {
+    if (frag_kind == 1u) return texelFetch(atlas, ivec2(frag_uv), 0).r;
+    float r = min(frag_shape.z, min(frag_shape.x, frag_shape.y));
+    vec2 q = abs(frag_uv) - frag_shape.xy + r;
+    float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;
+    if (frag_shape.w > 0.0) d = abs(d + frag_shape.w * 0.5) - frag_shape.w * 0.5;
+    float c = frag_blur > 0.0 ? 1.0 - smoothstep(-frag_blur, frag_blur, d) : clamp(0.5 - d, 0.0, 1.0);
+    return round(c * 255.0) / 255.0;
+}
 void main() {
+    if (any(lessThan(frag_pos, frag_clip.xy)) || any(greaterThan(frag_pos, frag_clip.zw))) discard;
     output_color = frag_col;
+    if (frag_kind != 0u) {
+        float a = round(frag_col.a * 255.0 * coverage());
+        if (a == 0.0) discard;
+        output_color.a = a / 255.0;
+    }
 })shdr";
 
-static constexpr usize VERTEX_STRIDE = 4 * sizeof(u32);
+static constexpr usize INSTANCE_STRIDE = 7 * sizeof(u32);
 
-struct vertex_t { f32 x, y, z; Color c; };
+static_assert(sizeof(rect_instance_t) == INSTANCE_STRIDE);
 
-static_assert(sizeof(vertex_t) == VERTEX_STRIDE);
+static i16 quantize(f32 v) { return i16(std::clamp(v, -32768.f, 32767.f)); }
 
-struct DrawBatchState {
-    DrawBatchState() {
+static rect_instance_t quantize_rect(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c) {
+    i16 x = quantize(x1), y = quantize(y1);
+    return {x, y, quantize(quantize(x2) - x), quantize(quantize(y2) - y), z, c};
+}
+
+// A clip rect in instance coordinates, truncated like them, so that clamping
+// before quantizing gives the intersection of the quantized boxes.
+struct ClipBox {
+    f32 x0, y0, x1, y1;
+    ClipBox(Rect const& r) : x0(quantize(r.x0)), y0(quantize(r.y0)), x1(quantize(r.x1)), y1(quantize(r.y1)) {}
+};
+
+// What quantize_rect leaves after the color of a solid rectangle.
+static void reset_tail(rect_instance_t& r) {
+    r.u = r.v = 0;
+    r.clip_x0 = r.clip_y0 = -32768;
+    r.clip_x1 = r.clip_y1 = 32767;
+}
+
+// A shape instance (see rect_instance_t): the quad grows by the blur.
+static rect_instance_t quantize_shape(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, f32 radius, f32 border, u32 blur) {
+    rect_instance_t r = quantize_rect(x1 - blur, x2 + blur, y1 - blur, y2 + blur, z, c);
+    r.u = rect_instance_t::SHAPE | u16(std::clamp(radius * 4.f + 0.5f, 0.f, 32767.f));
+    r.v = u16(std::clamp(border * 4.f + 0.5f, 0.f, 255.f)) | u16(blur << 8);
+    return r;
+}
+
+static_assert(offsetof(DrawBatch::RectCmd, c) == offsetof(DrawBatch::RectCmd, z) + sizeof(f32));
+
+// quantize_rect over n commands cropped to the clip box. With SSE2 the four coordinates of a command
+// are clamped and truncated at once; the sizes are subtracted in i32 and two
+// commands are packed to i16 with saturation, which is the same clamp.
+static void quantize_rects(DrawBatch::RectCmd const* r, usize n, rect_instance_t* out, ClipBox const& clip) {
+    usize i = 0;
+#if defined(__SSE2__)
+    // the clip box is within the i16 range, so clamping to it is the same clamp
+    const __m128 lo = _mm_setr_ps(clip.x0, clip.x0, clip.y0, clip.y0), hi = _mm_setr_ps(clip.x1, clip.x1, clip.y1, clip.y1);
+    auto corners = [&](DrawBatch::RectCmd const& cmd) {
+        // {x1, x2, y1, y2} -> {x1, y1, x2 - x1, y2 - y1}
+        __m128i v = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&cmd.x1), lo), hi));
+        __m128i origin = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128i ends = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+        return _mm_sub_epi32(ends, _mm_unpacklo_epi64(_mm_setzero_si128(), origin));
+    };
+    for (; i + 2 <= n; i += 2) {
+        __m128i boxes = _mm_packs_epi32(corners(r[i]), corners(r[i + 1]));
+        __m128i zc0 = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(&r[i].z));
+        __m128i zc1 = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(&r[i + 1].z));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi64(boxes, zc0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 1), _mm_unpacklo_epi64(_mm_srli_si128(boxes, 8), zc1));
+        reset_tail(out[i]);
+        reset_tail(out[i + 1]);
+    }
+#endif
+    auto cx = [&](f32 v) { return std::min(std::max(v, clip.x0), clip.x1); };
+    auto cy = [&](f32 v) { return std::min(std::max(v, clip.y0), clip.y1); };
+    for (; i < n; i++) out[i] = quantize_rect(cx(r[i].x1), cx(r[i].x2), cy(r[i].y1), cy(r[i].y2), r[i].z, r[i].c);
+}
+
+static void bind_instance_layout(u32 vao_id, u32 vbo_id, u32 quad_vbo_id) {
+    glBindVertexArray(vao_id);
+    glBindBuffer(GL_ARRAY_BUFFER, quad_vbo_id);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(f32), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glEnableVertexAttribArray(4);
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(1, 4, GL_SHORT, INSTANCE_STRIDE, (void*)0);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, INSTANCE_STRIDE, (void*)(4 * sizeof(i16)));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, INSTANCE_STRIDE, (void*)(4 * sizeof(i16) + sizeof(f32)));
+    glVertexAttribIPointer(4, 2, GL_UNSIGNED_SHORT, INSTANCE_STRIDE, (void*)offsetof(rect_instance_t, u));
+    glVertexAttribIPointer(5, 4, GL_SHORT, INSTANCE_STRIDE, (void*)offsetof(rect_instance_t, clip_x0));
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribDivisor(3, 1);
+    glVertexAttribDivisor(4, 1);
+    glVertexAttribDivisor(5, 1);
+}
+
+struct DrawArraysIndirectCommand {
+    u32 count;
+    u32 instance_count;
+    u32 first;
+    u32 base_instance;
+};
+
+// A retained layer: a range of the persistent instance buffer plus the layers
+// that were drawn while it was being recorded.
+struct LayerRange {
+    u32 first = 0;
+    u32 count = 0;
+    u32 capacity = 0;
+    bool live = false;
+    bool dirty = false;
+    // drawn in the last submitted frame, covering `shown`; `bounds` covers
+    // the current content
+    bool on_screen = false;
+    Rect bounds;
+    Rect shown;
+    std::vector<DrawBatch::Layer> children;
+};
+
+// Partial redraw: damage is merged into at most this many disjoint boxes,
+// since each one draws every instance again, clipped to it.
+static constexpr usize MAX_DAMAGE_BOXES = 4;
+// Above this share of the window, the frame is drawn whole in one pass.
+static constexpr f32 FULL_REDRAW_SHARE = 0.75f;
+
+static f32 area(Rect const& r) { return (r.x1 - r.x0) * (r.y1 - r.y0); }
+
+// What an instance can draw on: its quad within its clip box.
+static Rect instance_bounds(rect_instance_t const& r) {
+    Rect quad = { f32(std::min<i32>(r.x, r.x + r.w)), f32(std::min<i32>(r.y, r.y + r.h)), f32(std::max<i32>(r.x, r.x + r.w)), f32(std::max<i32>(r.y, r.y + r.h)) };
+    return quad.intersected({ f32(r.clip_x0), f32(r.clip_y0), f32(r.clip_x1), f32(r.clip_y1) });
+}
+
+// Box around the instances that draw anything; empty when none does.
+static Rect instance_bounds(rect_instance_t const* r, usize n) {
+    Rect b = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+    for (usize i = 0; i < n; i++) {
+        Rect ib = instance_bounds(r[i]);
+        if (!ib.empty()) b = b.united(ib);
+    }
+    return b;
+}
+
+static bool same_instance(rect_instance_t const& a, rect_instance_t const& b) {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Adds r to disjoint boxes, taking in the ones it overlaps and the ones it
+// extends without covering more than the two of them.
+static void add_damage(std::vector<Rect>& boxes, Rect r) {
+    for (usize i = 0; i < boxes.size();) {
+        Rect u = boxes[i].united(r);
+        if (!boxes[i].intersects(r) && area(u) > area(boxes[i]) + area(r)) {
+            i++;
+            continue;
+        }
+        r = u;
+        boxes[i] = boxes.back();
+        boxes.pop_back();
+        i = 0;
+    }
+    boxes.push_back(r);
+}
+
+// Rounds the damage out to whole pixels within the window and merges it into
+// at most MAX_DAMAGE_BOXES disjoint boxes, or the whole window when that
+// would be most of it. Returns the share of the window they cover.
+static f32 merge_damage(std::vector<Rect> const& damage, Size wnd, std::vector<Rect>& boxes) {
+    boxes.clear();
+    Rect window = Rect::from_size(wnd);
+    for (Rect r : damage) {
+        r = Rect{ std::floor(r.x0), std::floor(r.y0), std::ceil(r.x1), std::ceil(r.y1) }.intersected(window);
+        if (r.empty()) continue;
+        add_damage(boxes, r);
+        if (boxes.size() <= MAX_DAMAGE_BOXES) continue;
+        // merge the two boxes that waste the least
+        usize a = 0, b = 1;
+        f32 best = INFINITY;
+        for (usize i = 0; i < boxes.size(); i++) {
+            for (usize j = i + 1; j < boxes.size(); j++) {
+                f32 waste = area(boxes[i].united(boxes[j])) - area(boxes[i]) - area(boxes[j]);
+                if (waste < best) best = waste, a = i, b = j;
+            }
+        }
+        Rect u = boxes[a].united(boxes[b]);
+        boxes.erase(boxes.begin() + b);
+        boxes.erase(boxes.begin() + a);
+        add_damage(boxes, u);
+    }
+    if (window.empty()) return 0.f;
+    f32 covered = 0.f;
+    for (Rect const& b : boxes) covered += area(b);
+    if (covered <= FULL_REDRAW_SHARE * area(window)) return covered / area(window);
+    boxes.assign(1, window);
+    return 1.f;
+}
+
+static constexpr DrawBatch::Layer NO_LAYER = ~0u;
+
+// Number of frames the persistently mapped stream buffer is split into: the
+// CPU writes one segment while the GPU may still read the two previous ones.
+static constexpr u32 STREAM_SEGMENTS = 3;
+static constexpr usize STREAM_MIN_RECTS = 16384;
+
+// OpenGL objects of the GL backend.
+struct GLBackend {
+    GLBackend() {
+        const f32 unit_quad[] = { 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 1.f };
+        glGenBuffers(1, &quad_vbo_id);
+        glBindBuffer(GL_ARRAY_BUFFER, quad_vbo_id);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(unit_quad), unit_quad, GL_STATIC_DRAW);
+        glGenBuffers(1, &indirect_id);
         glGenVertexArrays(1, &vao_id);
         glGenBuffers(1, &vbo_id);
+        glGenVertexArrays(1, &retained_vao_id);
+        glGenBuffers(1, &retained_vbo_id);
         shdr.init(vtx_shdr, sizeof(vtx_shdr), fgr_shdr, sizeof(fgr_shdr));
-        glBindVertexArray(vao_id);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo_id);
-        glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_STRIDE, (void*)0);
-        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, VERTEX_STRIDE, (void*)(3 * sizeof(f32)));
+        bind_instance_layout(retained_vao_id, retained_vbo_id, quad_vbo_id);
+        bind_instance_layout(vao_id, vbo_id, quad_vbo_id);
+        if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) create_stream(STREAM_MIN_RECTS);
+        // the only texture: it stays bound to unit 0, which the sampler reads
+        glGenTextures(1, &atlas_id);
+        glBindTexture(GL_TEXTURE_2D, atlas_id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        resize_atlas(1, 1);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glBlendEquation(GL_FUNC_ADD);
     }
-    ~DrawBatchState() {
-
+    ~GLBackend() {
+        release_frame();
+        destroy_stream();
+        glDeleteBuffers(1, &quad_vbo_id);
+        glDeleteBuffers(1, &indirect_id);
+        glDeleteBuffers(1, &vbo_id);
+        glDeleteBuffers(1, &retained_vbo_id);
+        glDeleteVertexArrays(1, &vao_id);
+        glDeleteVertexArrays(1, &retained_vao_id);
+        glDeleteTextures(1, &atlas_id);
     }
+    u32 quad_vbo_id;
+    u32 indirect_id;
     u32 vao_id;
     u32 vbo_id;
     Shader shdr;
-    std::vector<vertex_t> vertex;
+
+    // Persistently mapped stream buffer: immediate rectangles are written
+    // straight into the current segment, and a fence per segment tells when
+    // the GPU is done reading it.
+    u32 stream_vao_id = 0;
+    u32 stream_vbo_id = 0;
+    rect_instance_t* stream_map = nullptr;
+    usize stream_capacity = 0;
+    u32 stream_segment = 0;
+    usize stream_count = 0;
+    usize stream_wanted = 0;
+    GLsync stream_fence[STREAM_SEGMENTS] = {};
+    void create_stream(usize capacity);
+    void destroy_stream();
+    void wait_stream_segment();
+    rect_instance_t* stream_base() { return stream_map + stream_segment * stream_capacity; }
+
+    u32 retained_vao_id;
+    u32 retained_vbo_id;
+
+    // Partial redraw: frames are drawn into this framebuffer, which keeps its
+    // content from one frame to the next (unlike the window's back buffers
+    // after a swap), and copied to the one bound when it was created, the
+    // window's. preserved is false until it holds a whole frame of the
+    // current size.
+    u32 frame_fbo = 0;
+    u32 window_fbo = 0;
+    u32 frame_color = 0, frame_depth = 0;
+    Size frame_size;
+    bool preserved = false;
+    bool frame_unsupported = false;
+    bool bind_frame(Size s);
+    void present_frame();
+    void release_frame();
+
+    u32 atlas_id;
+    u32 atlas_w = 0, atlas_h = 0;
+    void resize_atlas(u32 w, u32 h) {
+        std::vector<u8> zero(usize(w) * h, 0);
+        atlas_w = w, atlas_h = h;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, zero.data());
+    }
+    void write_atlas(u32 x, u32 y, u32 w, u32 h, u8 const* pixels) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, GL_RED, GL_UNSIGNED_BYTE, pixels);
+    }
 };
 
-DrawBatch::DrawBatch() {
-    DrawBatchState* s = new DrawBatchState;
+struct DrawBatchState {
+    DrawBatchState(DrawBatch::Backend backend) : backend(backend) {
+        if (backend == DrawBatch::Software) sw = new SoftwareRasterizer;
+        else if (backend == DrawBatch::OpenGL) gl = new GLBackend;
+    }
+    ~DrawBatchState() {
+        delete gl;
+        delete sw;
+    }
+    DrawBatch::Backend backend;
+    GLBackend* gl = nullptr;
+    SoftwareRasterizer* sw = nullptr;
+    Size wnd_size;
+    // Immediate rectangles that did not fit in the stream buffer, or all of
+    // them when it is not available.
+    std::vector<rect_instance_t> rects;
+
+    // Retained layers. `retained` mirrors the GPU buffer; only the ranges of
+    // layers recorded since the last submit are uploaded.
+    std::vector<rect_instance_t> retained;
+    usize retained_wasted = 0;
+    bool retained_full_upload = false;
+    // size of the GPU copy, which follows the mirror on submit
+    usize retained_gpu_capacity = 0;
+    std::vector<LayerRange> layers;
+    std::vector<DrawBatch::Layer> free_layers;
+    std::vector<DrawBatch::Layer> dirty_layers;
+
+    // Layers being recorded; recording_rects[i] holds the content of recording[i].
+    std::vector<DrawBatch::Layer> recording;
+    std::vector<std::vector<rect_instance_t>> recording_rects;
+    // Layers drawn outside of any recording since the last submit.
+    std::vector<DrawBatch::Layer> frame_layers;
+    std::vector<DrawArraysIndirectCommand> draws;
+    // draw_rectangles quantizes into this before claiming
+    std::vector<rect_instance_t> quantized;
+
+    // Software: the atlas the rasterizer samples.
+    std::vector<u8> atlas;
+    u32 atlas_w = 0, atlas_h = 0;
+
+    DrawBatch::Stats stats;
+    DrawBatch::Stats last_stats;
+
+    // Deferred: what submit recorded since the last take_frame.
+    FramePacket packet;
+    Color clear_color = 0xffffffffu;
+    // clear() was called since the last submit
+    bool cleared = false;
+
+    // Partial redraw. `damage` collects what changed since the last submit,
+    // and frame_damage is what the frame draws again, merged. shown_layers
+    // are the layers of the last frame in drawing order, drawn_layers those
+    // of the one being submitted.
+    bool partial_redraw = true;
+    bool damage_all = true;
+    Color shown_clear_color = 0xffffffffu;
+    Rect shown_immediate;
+    std::vector<Rect> damage;
+    std::vector<Rect> frame_damage;
+    std::vector<DrawBatch::Layer> shown_layers;
+    std::vector<DrawBatch::Layer> drawn_layers;
+
+    // Returns room for n rectangles in the layer being recorded, the stream
+    // buffer, or the fallback vector, in that order.
+    rect_instance_t* claim(usize n) {
+        if (recording.empty() && gl && gl->stream_map) {
+            gl->stream_wanted += n;
+            if (gl->stream_count + n <= gl->stream_capacity && rects.empty()) {
+                rect_instance_t* p = gl->stream_base() + gl->stream_count;
+                gl->stream_count += n;
+                return p;
+            }
+        }
+        auto& v = recording.empty() ? rects : recording_rects[recording.size() - 1];
+        usize at = v.size();
+        v.resize(at + n, {0, 0, 0, 0, 0, 0u});
+        return v.data() + at;
+    }
+    void store_layer(DrawBatch::Layer l, std::vector<rect_instance_t> const& v);
+    void compact();
+    void upload_retained();
+    void upload_range(u32 first, u32 count);
+    void collect_draws(DrawBatch::Layer l);
+    void collect_damage();
+    void submit_gl();
+    void submit_software();
+    void submit_deferred();
+};
+
+// Writes the recorded rectangles of a layer into its range, moving it to the end
+// of the buffer when it outgrew its capacity.
+void DrawBatchState::store_layer(DrawBatch::Layer l, std::vector<rect_instance_t> const& v) {
+    LayerRange& r = layers[l];
+    // On screen, only the instances that changed can draw anything else: with
+    // the same count they are compared one to one, otherwise what lies
+    // between the common start and end changed.
+    if (r.on_screen) {
+        rect_instance_t const* old = retained.data() + r.first;
+        if (v.size() == r.count) {
+            for (usize i = 0; i < v.size(); i++) {
+                if (same_instance(old[i], v[i])) continue;
+                damage.push_back(instance_bounds(old[i]));
+                damage.push_back(instance_bounds(v[i]));
+            }
+        } else {
+            usize head = 0, tail = 0, n = std::min<usize>(v.size(), r.count);
+            while (head < n && same_instance(old[head], v[head])) head++;
+            while (tail < n - head && same_instance(old[r.count - 1 - tail], v[v.size() - 1 - tail])) tail++;
+            damage.push_back(instance_bounds(old + head, r.count - head - tail));
+            damage.push_back(instance_bounds(v.data() + head, v.size() - head - tail));
+        }
+    }
+    r.bounds = instance_bounds(v.data(), v.size());
+    if (v.size() > r.capacity) {
+        retained_wasted += r.capacity;
+        r.capacity = std::max<u32>(v.size(), r.capacity * 2);
+        r.first = retained.size();
+        retained.resize(retained.size() + r.capacity, {0, 0, 0, 0, 0, 0u});
+    }
+    std::copy(v.begin(), v.end(), retained.begin() + r.first);
+    r.count = v.size();
+    if (!r.dirty) {
+        r.dirty = true;
+        dirty_layers.push_back(l);
+    }
+    if (retained_wasted > 4096 && retained_wasted * 2 > retained.size()) compact();
+}
+
+// Packs the live layers at the start of the buffer once more than half of it
+// is made of abandoned ranges.
+void DrawBatchState::compact() {
+    std::vector<rect_instance_t> packed;
+    packed.reserve(retained.size() - retained_wasted);
+    for (auto& r : layers) {
+        if (!r.live) continue;
+        u32 first = packed.size();
+        packed.insert(packed.end(), retained.begin() + r.first, retained.begin() + r.first + r.capacity);
+        r.first = first;
+    }
+    retained = std::move(packed);
+    retained_wasted = 0;
+    retained_full_upload = true;
+}
+
+// Brings the GPU copy of the retained mirror up to date: through GL, or in
+// the frame packet of a Deferred batch.
+void DrawBatchState::upload_retained() {
+    if (dirty_layers.empty() && !retained_full_upload) return;
+    if (gl) glBindBuffer(GL_ARRAY_BUFFER, gl->retained_vbo_id);
+    if (retained.size() > retained_gpu_capacity) {
+        retained_gpu_capacity = std::max<usize>(retained.size(), retained_gpu_capacity * 2);
+        if (gl) glBufferData(GL_ARRAY_BUFFER, retained_gpu_capacity * sizeof(rect_instance_t), nullptr, GL_DYNAMIC_DRAW);
+        retained_full_upload = true;
+    }
+    if (retained_full_upload) upload_range(0, retained.size());
+    for (auto l : dirty_layers) {
+        LayerRange& r = layers[l];
+        if (r.live && !retained_full_upload && r.count > 0) upload_range(r.first, r.count);
+        r.dirty = false;
+    }
+    dirty_layers.clear();
+    retained_full_upload = false;
+}
+
+void DrawBatchState::upload_range(u32 first, u32 count) {
+    if (gl) {
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(rect_instance_t), count * sizeof(rect_instance_t), retained.data() + first);
+    } else {
+        packet.uploads.push_back({ first, count });
+        packet.upload_data.insert(packet.upload_data.end(), retained.begin() + first, retained.begin() + first + count);
+    }
+    stats.uploaded_bytes += count * sizeof(rect_instance_t);
+}
+
+void GLBackend::create_stream(usize capacity) {
+    stream_capacity = capacity;
+    usize size = STREAM_SEGMENTS * stream_capacity * sizeof(rect_instance_t);
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenVertexArrays(1, &stream_vao_id);
+    glGenBuffers(1, &stream_vbo_id);
+    bind_instance_layout(stream_vao_id, stream_vbo_id, quad_vbo_id);
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    stream_map = reinterpret_cast<rect_instance_t*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    if (!stream_map) destroy_stream();
+    stream_segment = 0;
+    stream_count = 0;
+}
+
+void GLBackend::destroy_stream() {
+    for (auto& f : stream_fence) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    if (stream_map) {
+        glBindBuffer(GL_ARRAY_BUFFER, stream_vbo_id);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glDeleteBuffers(1, &stream_vbo_id);
+    glDeleteVertexArrays(1, &stream_vao_id);
+    stream_map = nullptr;
+    stream_vbo_id = stream_vao_id = 0;
+    stream_capacity = 0;
+}
+
+// Binds the frame buffer for drawing, sized to s. Returns false when the
+// driver cannot render into it, leaving the window's framebuffer bound.
+bool GLBackend::bind_frame(Size s) {
+    if (frame_unsupported) return false;
+    if (!frame_fbo) {
+        GLint bound = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+        window_fbo = bound;
+        glGenFramebuffers(1, &frame_fbo);
+        glGenRenderbuffers(1, &frame_color);
+        glGenRenderbuffers(1, &frame_depth);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_fbo);
+    if (s == frame_size) return true;
+    frame_size = s;
+    preserved = false;
+    glBindRenderbuffer(GL_RENDERBUFFER, frame_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, s.w, s.h);
+    glBindRenderbuffer(GL_RENDERBUFFER, frame_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, s.w, s.h);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, frame_color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, frame_depth);
+    if (s.w == 0 || s.h == 0 || glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) return true;
+    release_frame();
+    frame_unsupported = true;
+    return false;
+}
+
+// Copies the frame to the window; the frame buffer stays bound, so reading
+// pixels back gets the frame even after the window was swapped.
+void GLBackend::present_frame() {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frame_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, window_fbo);
+    glBlitFramebuffer(0, 0, frame_size.w, frame_size.h, 0, 0, frame_size.w, frame_size.h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, frame_fbo);
+}
+
+void GLBackend::release_frame() {
+    if (!frame_fbo) return;
+    glBindFramebuffer(GL_FRAMEBUFFER, window_fbo);
+    glDeleteFramebuffers(1, &frame_fbo);
+    glDeleteRenderbuffers(1, &frame_color);
+    glDeleteRenderbuffers(1, &frame_depth);
+    frame_fbo = frame_color = frame_depth = 0;
+    frame_size = Size();
+    preserved = false;
+}
+
+// Blocks until the GPU no longer reads the segment about to be written.
+void GLBackend::wait_stream_segment() {
+    GLsync& f = stream_fence[stream_segment];
+    if (!f) return;
+    while (glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+    glDeleteSync(f);
+    f = nullptr;
+}
+
+void DrawBatchState::collect_draws(DrawBatch::Layer l) {
+    LayerRange const& r = layers[l];
+    if (!r.live) return;
+    drawn_layers.push_back(l);
+    if (r.count > 0) draws.push_back({4, r.count, 0, r.first});
+    for (auto c : r.children) collect_draws(c);
+}
+
+// Turns what changed since the last frame into frame_damage, and makes the
+// layers drawn this frame the ones on screen.
+void DrawBatchState::collect_damage() {
+    // layers that appeared, went away or moved in the drawing order
+    usize same = 0;
+    while (same < shown_layers.size() && same < drawn_layers.size() && shown_layers[same] == drawn_layers[same]) same++;
+    for (usize i = same; i < shown_layers.size(); i++) {
+        if (shown_layers[i] != NO_LAYER) damage.push_back(layers[shown_layers[i]].shown);
+    }
+    for (usize i = same; i < drawn_layers.size(); i++) damage.push_back(layers[drawn_layers[i]].bounds);
+    for (auto l : shown_layers) {
+        if (l != NO_LAYER) layers[l].on_screen = false;
+    }
+    for (auto l : drawn_layers) {
+        layers[l].on_screen = true;
+        layers[l].shown = layers[l].bounds;
+    }
+    shown_layers.swap(drawn_layers);
+    drawn_layers.clear();
+    // immediate rectangles are new every frame
+    Rect immediate = instance_bounds(rects.data(), rects.size());
+    if (gl && gl->stream_count > 0) immediate = immediate.united(instance_bounds(gl->stream_base(), gl->stream_count));
+    damage.push_back(shown_immediate);
+    damage.push_back(immediate);
+    shown_immediate = immediate;
+    if (!(clear_color == shown_clear_color)) damage_all = true;
+    shown_clear_color = clear_color;
+    if (damage_all || !partial_redraw) damage.push_back(Rect::from_size(wnd_size));
+    damage_all = false;
+    stats.redrawn_fraction = merge_damage(damage, wnd_size, frame_damage);
+    damage.clear();
+}
+
+// Draws the frame once, or once per damage box with the scissor test limiting
+// the clear and the draws to it.
+void DrawBatchState::submit_gl() {
+    if (!draws.empty()) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gl->indirect_id);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, draws.size() * sizeof(draws[0]), draws.data(), GL_STREAM_DRAW);
+    }
+    if (gl->stream_count > 0) stats.uploaded_bytes += gl->stream_count * sizeof(rect_instance_t);
+    if (!rects.empty()) {
+        glBindBuffer(GL_ARRAY_BUFFER, gl->vbo_id);
+        usize data_size = rects.size() * sizeof(rects[0]);
+        glBufferData(GL_ARRAY_BUFFER, data_size, rects.data(), GL_DYNAMIC_DRAW);
+        stats.uploaded_bytes += data_size;
+    }
+    auto draw = [&] {
+        if (!draws.empty()) {
+            glBindVertexArray(gl->retained_vao_id);
+            glMultiDrawArraysIndirect(GL_TRIANGLE_STRIP, nullptr, draws.size(), 0);
+            stats.draw_calls++;
+        }
+        if (gl->stream_count > 0) {
+            glBindVertexArray(gl->stream_vao_id);
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, gl->stream_count, gl->stream_segment * gl->stream_capacity);
+            stats.draw_calls++;
+        }
+        if (!rects.empty()) {
+            glBindVertexArray(gl->vao_id);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, rects.size());
+            stats.draw_calls++;
+        }
+    };
+    bool in_frame = partial_redraw && gl->bind_frame(wnd_size);
+    if (cleared) {
+        glClearColor(clear_color.r / 255.f, clear_color.g / 255.f, clear_color.b / 255.f, clear_color.a / 255.f);
+        glClearDepth(1);
+    }
+    if (cleared && in_frame && gl->preserved) {
+        glEnable(GL_SCISSOR_TEST);
+        for (Rect const& b : frame_damage) {
+            glScissor(b.x0, wnd_size.h - b.y1, b.x1 - b.x0, b.y1 - b.y0);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            draw();
+        }
+        glDisable(GL_SCISSOR_TEST);
+    } else {
+        if (cleared) glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        draw();
+        stats.redrawn_fraction = 1.f;
+    }
+    if (in_frame) {
+        if (cleared) gl->preserved = true;
+        gl->present_frame();
+    }
+    if (gl->stream_map) {
+        gl->stream_fence[gl->stream_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        gl->stream_segment = (gl->stream_segment + 1) % STREAM_SEGMENTS;
+        // a frame spilled into the fallback vector: make the ring big enough for it
+        if (gl->stream_wanted > gl->stream_capacity) {
+            usize capacity = gl->stream_capacity;
+            while (capacity < gl->stream_wanted) capacity *= 2;
+            glFinish();
+            gl->destroy_stream();
+            gl->create_stream(capacity);
+        }
+        gl->wait_stream_segment();
+        gl->stream_count = 0;
+        gl->stream_wanted = 0;
+    }
+}
+
+// The rasterizer reads the retained mirror directly, so there is nothing to upload.
+void DrawBatchState::submit_software() {
+    for (auto l : dirty_layers) layers[l].dirty = false;
+    dirty_layers.clear();
+    retained_full_upload = false;
+    sw->set_atlas(atlas.data(), atlas_w, atlas_h);
+    // the framebuffer keeps the previous frame as long as it is not resized,
+    // which damages all of it
+    bool whole = !cleared || !partial_redraw;
+    sw->set_scissor(whole ? std::span<Rect const>() : std::span<Rect const>(frame_damage));
+    if (cleared) sw->clear(clear_color);
+    if (whole) stats.redrawn_fraction = 1.f;
+    else if (frame_damage.empty()) return;
+    for (auto const& d : draws) sw->draw(retained.data() + d.base_instance, d.instance_count);
+    sw->draw(rects.data(), rects.size());
+    sw->flush();
+    stats.draw_calls++;
+}
+
+// Counts what the executing batch will upload and draw, so the stats of the
+// recording side look like those of a direct OpenGL batch.
+void DrawBatchState::submit_deferred() {
+    upload_retained();
+    packet.wnd_size = wnd_size;
+    packet.clear_color = clear_color;
+    packet.retained_capacity = retained_gpu_capacity;
+    packet.draws.clear();
+    for (auto const& d : draws) packet.draws.push_back({ d.base_instance, d.instance_count });
+    if (!draws.empty()) stats.draw_calls++;
+    packet.rects.swap(rects);
+    // frames submitted before this one and not taken yet are replaced, so
+    // what changed in them must be drawn too
+    packet.damage.insert(packet.damage.end(), frame_damage.begin(), frame_damage.end());
+    if (!packet.rects.empty()) {
+        stats.uploaded_bytes += packet.rects.size() * sizeof(rect_instance_t);
+        stats.draw_calls++;
+    }
+}
+
+DrawBatch::DrawBatch(Backend backend) {
+    DrawBatchState* s = new DrawBatchState(backend);
     state = s;
 }
 
@@ -98,33 +837,320 @@ DrawBatch::~DrawBatch() {
     delete s;
 }
 
+DrawBatch::Backend DrawBatch::get_backend() const {
+    return reinterpret_cast<DrawBatchState*>(state)->backend;
+}
+
 void DrawBatch::update_wnd_size(Size s) {
     DrawBatchState* st = reinterpret_cast<DrawBatchState*>(state);
+    st->wnd_size = s;
+    st->damage_all = true;
+    if (st->sw) {
+        st->sw->resize(s.w, s.h);
+        return;
+    }
+    if (!st->gl) return;
     f32 matrix[] = {
         2.f / s.w,  0.f      ,  0.f   , -1.f,
         0.f      , -2.f / s.h,  0.f   ,  1.f,
         0.f      ,  0.f      , -0.001f,  0.f,
         0.f      ,  0.f      ,  0.f   ,  1.f
     };
-    glUniformMatrix4fv(st->shdr.uniform_loc, 1, GL_TRUE, matrix);
+    glUniformMatrix4fv(st->gl->shdr.uniform_loc, 1, GL_TRUE, matrix);
+    glViewport(0, 0, s.w, s.h);
 }
 
-void DrawBatch::draw_rectangle(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c) {
+// Takes effect on submit, which only clears what the frame draws again.
+void DrawBatch::clear(Color c) {
     auto *s = reinterpret_cast<DrawBatchState*>(state);
-    s->vertex.push_back({x1, y1, z, c});
-    s->vertex.push_back({x2, y1, z, c});
-    s->vertex.push_back({x2, y2, z, c});
-    s->vertex.push_back({x1, y1, z, c});
-    s->vertex.push_back({x2, y2, z, c});
-    s->vertex.push_back({x1, y2, z, c});
+    s->clear_color = c;
+    s->cleared = true;
+}
+
+void DrawBatch::draw_rectangle(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, Rect const& clip) {
+    rect_instance_t r = quantize_rect(x1, x2, y1, y2, z, c);
+    if (clip_instance(r, clip)) *reinterpret_cast<DrawBatchState*>(state)->claim(1) = r;
+}
+
+// Against a clip rect they are quantized a chunk at a time into scratch
+// room, where the rectangles the clip left empty are dropped, so that only
+// the others are claimed: the claimed room may be mapped GPU memory, which is
+// not to be read back.
+void DrawBatch::draw_rectangles(std::span<RectCmd const> rects, Rect const& clip) {
+    if (rects.empty()) return;
+    if (clip == Rect::everything()) {
+        quantize_rects(rects.data(), rects.size(), claim(rects.size()), ClipBox(clip));
+        return;
+    }
+    static constexpr usize CHUNK = 256;
+    auto& quantized = reinterpret_cast<DrawBatchState*>(state)->quantized;
+    quantized.resize(CHUNK, {0, 0, 0, 0, 0, 0u});
+    rect_instance_t* chunk = quantized.data();
+    ClipBox box(clip);
+    for (usize at = 0; at < rects.size(); at += CHUNK) {
+        usize n = std::min(CHUNK, rects.size() - at);
+        quantize_rects(rects.data() + at, n, chunk, box);
+        usize kept = 0;
+        for (usize i = 0; i < n; i++) {
+            if (chunk[i].w != 0 && chunk[i].h != 0) chunk[kept++] = chunk[i];
+        }
+        if (kept) std::copy_n(chunk, kept, claim(kept));
+    }
+}
+
+void DrawBatch::draw_rounded_rectangle(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, f32 radius, f32 border, Rect const& clip) {
+    rect_instance_t r = quantize_shape(x1, x2, y1, y2, z, c, radius, border, 0);
+    if (clip_instance(r, clip)) *claim(1) = r;
+}
+
+void DrawBatch::draw_shadow(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, f32 radius, f32 blur, Rect const& clip) {
+    rect_instance_t r = quantize_shape(x1, x2, y1, y2, z, c, radius, 0.f, u32(std::clamp(blur + 0.5f, 0.f, 255.f)));
+    if (clip_instance(r, clip)) *claim(1) = r;
+}
+
+bool DrawBatch::clip_instance(rect_instance_t& r, Rect const& clip) {
+    // on top of the clip box the instance may already have
+    ClipBox box(clip);
+    i32 cx0 = std::max<i32>(box.x0, r.clip_x0), cy0 = std::max<i32>(box.y0, r.clip_y0);
+    i32 cx1 = std::min<i32>(box.x1, r.clip_x1), cy1 = std::min<i32>(box.y1, r.clip_y1);
+    i32 x0 = std::min<i32>(r.x, r.x + r.w), x1 = std::max<i32>(r.x, r.x + r.w);
+    i32 y0 = std::min<i32>(r.y, r.y + r.h), y1 = std::max<i32>(r.y, r.y + r.h);
+    if (x0 >= x1 || y0 >= y1 || x1 <= cx0 || cx1 <= x0 || y1 <= cy0 || cy1 <= y0) return false;
+    if (cx0 <= x0 && x1 <= cx1 && cy0 <= y0 && y1 <= cy1) return true;
+    if (r.u & rect_instance_t::SHAPE) {
+        r.clip_x0 = cx0, r.clip_y0 = cy0, r.clip_x1 = cx1, r.clip_y1 = cy1;
+        return true;
+    }
+    // glyph texels map one to one onto pixels, so the crop moves them alike
+    i32 nx0 = std::max(x0, cx0), ny0 = std::max(y0, cy0);
+    if (r.u | r.v) r.u += nx0 - x0, r.v += ny0 - y0;
+    r.x = nx0, r.y = ny0;
+    r.w = std::min(x1, cx1) - nx0, r.h = std::min(y1, cy1) - ny0;
+    return true;
+}
+
+rect_instance_t* DrawBatch::claim(usize n) {
+    return reinterpret_cast<DrawBatchState*>(state)->claim(n);
+}
+
+void DrawBatch::set_atlas_size(u32 w, u32 h) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    s->damage_all = true;
+    if (s->gl) {
+        s->gl->resize_atlas(w, h);
+        return;
+    }
+    s->atlas_w = w, s->atlas_h = h;
+    if (s->sw) {
+        s->atlas.assign(usize(w) * h, 0);
+        return;
+    }
+    // a resize drops the writes before it
+    s->packet.atlas_w = w, s->packet.atlas_h = h;
+    s->packet.atlas_writes.clear();
+    s->packet.atlas_data.clear();
+}
+
+void DrawBatch::write_atlas(u32 x, u32 y, u32 w, u32 h, u8 const* pixels) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    if (s->gl) {
+        s->gl->write_atlas(x, y, w, h, pixels);
+    } else if (s->sw) {
+        for (u32 row = 0; row < h; row++) std::copy(pixels + usize(row) * w, pixels + usize(row + 1) * w, s->atlas.begin() + usize(y + row) * s->atlas_w + x);
+    } else {
+        s->packet.atlas_writes.push_back({x, y, w, h});
+        s->packet.atlas_data.insert(s->packet.atlas_data.end(), pixels, pixels + usize(w) * h);
+    }
+    s->stats.uploaded_bytes += usize(w) * h;
+}
+
+DrawBatch::Layer DrawBatch::create_layer() {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    Layer l;
+    if (!s->free_layers.empty()) {
+        l = s->free_layers.back();
+        s->free_layers.pop_back();
+    } else {
+        l = s->layers.size();
+        s->layers.emplace_back();
+    }
+    s->layers[l].live = true;
+    return l;
+}
+
+void DrawBatch::destroy_layer(Layer l) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    LayerRange& r = s->layers[l];
+    s->retained_wasted += r.capacity;
+    if (r.on_screen) s->damage.push_back(r.shown);
+    // a layer created with the same handle is a different one
+    std::replace(s->shown_layers.begin(), s->shown_layers.end(), l, NO_LAYER);
+    r.on_screen = false;
+    r.bounds = r.shown = Rect();
+    r.live = false;
+    r.count = r.capacity = 0;
+    r.children.clear();
+    s->free_layers.push_back(l);
+}
+
+void DrawBatch::begin_layer(Layer l) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    usize depth = s->recording.size();
+    s->recording.push_back(l);
+    if (s->recording_rects.size() <= depth) s->recording_rects.emplace_back();
+    s->recording_rects[depth].clear();
+    s->layers[l].children.clear();
+}
+
+void DrawBatch::end_layer() {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    Layer l = s->recording.back();
+    s->recording.pop_back();
+    s->store_layer(l, s->recording_rects[s->recording.size()]);
+}
+
+void DrawBatch::draw_layer(Layer l) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    if (s->recording.empty()) s->frame_layers.push_back(l);
+    else s->layers[s->recording.back()].children.push_back(l);
+}
+
+bool DrawBatch::set_persistent_streaming(bool enable) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    if (!s->gl) return false;
+    if (!enable && s->gl->stream_map) s->gl->destroy_stream();
+    if (enable && !s->gl->stream_map && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage)) s->gl->create_stream(STREAM_MIN_RECTS);
+    return s->gl->stream_map != nullptr;
+}
+
+void DrawBatch::set_partial_redraw(bool enable) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    if (enable == s->partial_redraw) return;
+    s->partial_redraw = enable;
+    s->damage_all = true;
+    if (s->gl && !enable) s->gl->release_frame();
+}
+
+void DrawBatch::damage(Rect const& r) {
+    reinterpret_cast<DrawBatchState*>(state)->damage.push_back(r);
+}
+
+DrawBatch::Stats const& DrawBatch::last_frame_stats() const {
+    return reinterpret_cast<DrawBatchState*>(state)->last_stats;
+}
+
+void DrawBatch::count_culled(usize widgets) {
+    reinterpret_cast<DrawBatchState*>(state)->stats.culled_widgets += widgets;
 }
 
 void DrawBatch::submit() {
+    PROFILE_ZONE("submit");
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    s->draws.clear();
+    for (auto l : s->frame_layers) s->collect_draws(l);
+    s->frame_layers.clear();
+    s->collect_damage();
+    if (s->sw) {
+        s->submit_software();
+    } else if (s->gl) {
+        s->upload_retained();
+        s->submit_gl();
+    } else {
+        s->submit_deferred();
+    }
+    // what a frame drew over the previous one without clearing is not known
+    if (!s->cleared) s->damage_all = true;
+    s->cleared = false;
+    s->rects.clear();
+    s->last_stats = s->stats;
+    s->stats = {};
+}
+
+void DrawBatch::take_frame(FramePacket& out) {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    std::swap(out, s->packet);
+    s->packet.uploads.clear();
+    s->packet.upload_data.clear();
+    s->packet.draws.clear();
+    s->packet.rects.clear();
+    s->packet.atlas_w = s->atlas_w, s->packet.atlas_h = s->atlas_h;
+    s->packet.atlas_writes.clear();
+    s->packet.atlas_data.clear();
+    s->packet.damage.clear();
+}
+
+void DrawBatch::execute(FramePacket const& p) {
+    PROFILE_ZONE("execute");
     auto *s = reinterpret_cast<DrawBatchState*>(state);
-    glBindBuffer(GL_ARRAY_BUFFER, s->vbo_id);
-    usize data_size = s->vertex.size() * sizeof(s->vertex[0]);
-    glBufferData(GL_ARRAY_BUFFER, data_size, s->vertex.data(), GL_DYNAMIC_DRAW);
-    glBindVertexArray(s->vao_id);
-    glDrawArrays(GL_TRIANGLES, 0, s->vertex.size());
-    s->vertex.clear();
+    GLBackend* gl = s->gl;
+    if (!gl) return;
+    if (p.wnd_size != s->wnd_size) update_wnd_size(p.wnd_size);
+    clear(p.clear_color);
+    s->stats.redrawn_fraction = merge_damage(p.damage, p.wnd_size, s->frame_damage);
+    glBindBuffer(GL_ARRAY_BUFFER, gl->retained_vbo_id);
+    // a new size comes with an upload of the whole buffer
+    if (p.retained_capacity != s->retained_gpu_capacity) {
+        s->retained_gpu_capacity = p.retained_capacity;
+        glBufferData(GL_ARRAY_BUFFER, s->retained_gpu_capacity * sizeof(rect_instance_t), nullptr, GL_DYNAMIC_DRAW);
+    }
+    usize at = 0;
+    for (auto u : p.uploads) {
+        glBufferSubData(GL_ARRAY_BUFFER, u.first * sizeof(rect_instance_t), u.count * sizeof(rect_instance_t), p.upload_data.data() + at);
+        s->stats.uploaded_bytes += u.count * sizeof(rect_instance_t);
+        at += u.count;
+    }
+    if (p.atlas_w != gl->atlas_w || p.atlas_h != gl->atlas_h) gl->resize_atlas(p.atlas_w, p.atlas_h);
+    at = 0;
+    for (auto w : p.atlas_writes) {
+        gl->write_atlas(w.x, w.y, w.w, w.h, p.atlas_data.data() + at);
+        s->stats.uploaded_bytes += usize(w.w) * w.h;
+        at += usize(w.w) * w.h;
+    }
+    s->draws.clear();
+    for (auto d : p.draws) s->draws.push_back({4, d.count, 0, d.first});
+    // immediate rectangles take the same way as when drawn directly
+    gl->stream_wanted = p.rects.size();
+    if (gl->stream_map && p.rects.size() <= gl->stream_capacity) {
+        std::copy(p.rects.begin(), p.rects.end(), gl->stream_base());
+        gl->stream_count = p.rects.size();
+    } else {
+        s->rects = p.rects;
+    }
+    s->submit_gl();
+    s->cleared = false;
+    s->rects.clear();
+    s->last_stats = s->stats;
+    s->stats = {};
+}
+
+std::vector<u8> DrawBatch::read_pixels() const {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    if (!s->sw && !s->gl) return {};
+    if (s->sw) return std::vector<u8>(s->sw->pixels(), s->sw->pixels() + usize(s->sw->width()) * s->sw->height() * 4);
+    usize w = s->wnd_size.w, h = s->wnd_size.h, row = w * 4;
+    std::vector<u8> pixels(row * h);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (s->gl->frame_fbo) glBindFramebuffer(GL_READ_FRAMEBUFFER, s->gl->frame_fbo);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    // GL rows start at the bottom
+    for (usize y = 0; y < h / 2; y++) std::swap_ranges(pixels.begin() + y * row, pixels.begin() + (y + 1) * row, pixels.begin() + (h - 1 - y) * row);
+    return pixels;
+}
+
+bool DrawBatch::write_ppm(const char* path) const {
+    auto *s = reinterpret_cast<DrawBatchState*>(state);
+    usize w = s->wnd_size.w, h = s->wnd_size.h;
+    std::vector<u8> rgba = read_pixels();
+    if (rgba.empty()) return false;
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%zu %zu\n255\n", (size_t)w, (size_t)h);
+    std::vector<u8> rgb(w * 3);
+    for (usize y = 0; y < h; y++) {
+        for (usize x = 0; x < w; x++) {
+            for (usize c = 0; c < 3; c++) rgb[x * 3 + c] = rgba[(y * w + x) * 4 + c];
+        }
+        fwrite(rgb.data(), 1, rgb.size(), f);
+    }
+    return fclose(f) == 0;
 }
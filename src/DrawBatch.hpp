@@ -2,15 +2,148 @@
 #define DRAWBACTH_H_
 
 #include "types.hpp"
+#include <span>
+#include <vector>
+
+// Per-rectangle instance record: pixel position and size quantized to i16,
+// depth, and color. This is what both backends consume. Glyph quads also
+// carry the atlas texel of their top-left corner, and the atlas coverage
+// scales their alpha; solid rectangles leave it at 0, 0, which the atlas
+// never hands out. Analytic shapes set SHAPE in u instead, which no atlas
+// texel has: the rest of u is the corner radius and v packs the border width
+// (low byte, 0 fills the shape) and the edge blur (high byte). Radius and
+// border are in quarter pixels; the blur is in whole pixels, since the quad
+// covers that much more than the shape on every side.
+// Pixels outside of the clip box [clip_x0, clip_x1) x [clip_y0, clip_y1) are
+// not drawn. Rectangles and glyphs are cropped when they are recorded
+// instead, so only shapes crossing the edge of a clip rect set it.
+struct rect_instance_t {
+    static constexpr u16 SHAPE = 0x8000;
+    i16 x, y, w, h; f32 z; Color c; u16 u = 0, v = 0;
+    i16 clip_x0 = -32768, clip_y0 = -32768, clip_x1 = 32767, clip_y1 = 32767;
+};
+
+// A frame recorded by a Deferred DrawBatch, in plain memory: everything an
+// OpenGL batch on another thread needs to draw it. The retained buffer on the
+// GPU side is updated by each packet in turn, so none may be skipped.
+struct FramePacket {
+    struct Range { u32 first, count; };
+    Size wnd_size;
+    Color clear_color = 0xffffffffu;
+    // size of the retained buffer, and the ranges of it written since the
+    // previous packet with their content
+    usize retained_capacity = 0;
+    std::vector<Range> uploads;
+    std::vector<rect_instance_t> upload_data;
+    // retained ranges to draw, then the immediate rectangles
+    std::vector<Range> draws;
+    std::vector<rect_instance_t> rects;
+    // atlas size, and the regions written since the previous packet with
+    // their pixels
+    struct AtlasWrite { u32 x, y, w, h; };
+    u32 atlas_w = 0, atlas_h = 0;
+    std::vector<AtlasWrite> atlas_writes;
+    std::vector<u8> atlas_data;
+    // parts of the window that differ from the previous packet's frame, in
+    // whole pixels; the rest may be kept as it is (see set_partial_redraw)
+    std::vector<Rect> damage;
+};
 
 class DrawBatch {
     void* state;
 public:
-    DrawBatch();
+    enum Backend {
+        OpenGL,
+        // Rasterizes on the CPU into an RGBA framebuffer; needs no GL context.
+        Software,
+        // Makes no GL calls: submit() records the frame into a FramePacket,
+        // which an OpenGL batch executes, possibly on another thread.
+        Deferred,
+    };
+    DrawBatch(Backend backend = OpenGL);
     ~DrawBatch();
-    void draw_rectangle(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c);
+    Backend get_backend() const;
+    using Layer = u32;
+    void clear(Color c);
+    // Drawing calls take the clip rect their pixels must stay in, in window
+    // coordinates and rounded like the primitives. It never splits the frame
+    // into more draw calls: what it fully rejects is not recorded.
+    void draw_rectangle(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, Rect const& clip = Rect::everything());
+    // Arguments of one draw_rectangle call.
+    struct RectCmd { f32 x1, x2, y1, y2, z; Color c = 0u; };
+    // Same as calling draw_rectangle for each, with the coordinates quantized
+    // several at a time. Rectangles left empty by the clip rect are dropped;
+    // without one, all of them are recorded with a single claim.
+    void draw_rectangles(std::span<RectCmd const> rects, Rect const& clip = Rect::everything());
+    // Room for n rectangles, to be filled by the caller before the next call
+    // on this batch; positions and sizes are in pixels.
+    rect_instance_t* claim(usize n);
+    // Applies a clip rect to an instance before it is claimed: rectangles and
+    // glyphs are cropped, shapes crossing its edge get its box. Returns false
+    // when nothing of the instance is left to draw.
+    static bool clip_instance(rect_instance_t& r, Rect const& clip);
+    // A rounded rectangle, or only a border of that width inside its edge,
+    // with anti-aliased edges computed per pixel from the distance to the
+    // shape. A radius of half the smaller side makes a pill or a circle.
+    void draw_rounded_rectangle(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, f32 radius, f32 border = 0.f, Rect const& clip = Rect::everything());
+    // The same shape with its edge faded over `blur` pixels on both sides,
+    // as a soft shadow.
+    void draw_shadow(f32 x1, f32 x2, f32 y1, f32 y2, f32 z, Color c, f32 radius, f32 blur, Rect const& clip = Rect::everything());
+    // One-channel coverage texture sampled by textured instances (see
+    // rect_instance_t). Resizing clears it; writes take w * h bytes, rows
+    // top first.
+    void set_atlas_size(u32 w, u32 h);
+    void write_atlas(u32 x, u32 y, u32 w, u32 h, u8 const* pixels);
+    // Retained layers own a range of a persistent instance buffer. Drawing
+    // between begin_layer and end_layer replaces the content of the layer, and
+    // only that range is uploaded on the next submit. Layers may be recorded
+    // inside other layers; draw_layer inside a recording makes the layer a
+    // child of the one being recorded, drawn after its own content.
+    Layer create_layer();
+    void destroy_layer(Layer l);
+    void begin_layer(Layer l);
+    void end_layer();
+    // Draws a layer (and its children) this frame, or adds it as a child of
+    // the layer being recorded.
+    void draw_layer(Layer l);
     void submit();
+    // Deferred: hands over the frames submitted since the last call, and
+    // keeps the buffers `out` held for the next ones.
+    void take_frame(FramePacket& out);
+    // OpenGL: draws a frame recorded by a Deferred batch.
+    void execute(FramePacket const& p);
+    // Immediate rectangles are written straight into a triple-buffered,
+    // persistently mapped buffer when the driver supports buffer storage
+    // (the default); otherwise they are uploaded with glBufferData on submit.
+    // Returns whether the persistent path is active.
+    bool set_persistent_streaming(bool enable);
+    // On by default: a frame that starts with clear() is only cleared and
+    // drawn again inside the parts of the window that can differ from the
+    // previous frame. Those are found on submit, from the instances that
+    // changed in layers recorded again, the layers that appeared, went away
+    // or moved in the drawing order, and the immediate rectangles of both
+    // frames, and merged into a few disjoint boxes, each drawn as a scissored
+    // pass. OpenGL batches then draw into a framebuffer of their own, which
+    // keeps the previous frame, and copy it to the window. When most of the
+    // window changed, or with partial redraw off, frames are drawn whole.
+    void set_partial_redraw(bool enable);
+    // Draws r, in window coordinates, again in the next frame even if the
+    // instances there did not change, e.g. when atlas texels they sample
+    // were rewritten.
+    void damage(Rect const& r);
+    struct Stats {
+        usize uploaded_bytes = 0; // instance bytes written to GPU-visible memory
+        u32 draw_calls = 0;
+        usize culled_widgets = 0; // skipped by paint as outside the clip rect
+        f32 redrawn_fraction = 0.f; // of the window pixels, cleared and drawn again
+    };
+    Stats const& last_frame_stats() const;
+    void count_culled(usize widgets);
     void update_wnd_size(Size s);
+    // RGBA8 pixels of the last submitted frame, top row first. Empty for
+    // Deferred batches.
+    std::vector<u8> read_pixels() const;
+    bool write_ppm(const char* path) const;
 };
 
 #endif // DRAWBACTH_H_
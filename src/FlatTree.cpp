@@ -0,0 +1,353 @@
+#include "FlatTree.hpp"
+#include "widgets/Flex.hpp"
+#include "widgets/Position.hpp"
+#include <cmath>
+
+void FlatTree::compile(Widget* root) {
+    kind.clear();
+    next_sibling.clear();
+    child_count.clear();
+    params.clear();
+    flex.clear();
+    fit.clear();
+    widget.clear();
+    opaque.clear();
+    parent.clear();
+    positions.clear();
+    if (!root) return;
+    std::vector<u32> last_child;
+    compile_stack.clear();
+    compile_stack.push_back({ root, NONE });
+    // children are pushed in reverse, so each subtree is emitted in full
+    // right after its root and before the next sibling
+    while (!compile_stack.empty()) {
+        auto [w, p] = compile_stack.back();
+        compile_stack.pop_back();
+        u32 i = kind.size();
+        FlatNode node = w->lower();
+        kind.push_back(node.kind);
+        params.push_back(node);
+        parent.push_back(p);
+        next_sibling.push_back(NONE);
+        child_count.push_back(0);
+        last_child.push_back(NONE);
+        flex.push_back(w->props.get_i32(WidgetProps::PropFlex).value_or(0));
+        fit.push_back(w->props.get_i32(WidgetProps::PropFit).value_or(Flex::FitTight));
+        widget.push_back(w);
+        positions.push_back(w->get_render_pos());
+        if (p != NONE) {
+            if (last_child[p] != NONE) next_sibling[last_child[p]] = i;
+            last_child[p] = i;
+            child_count[p]++;
+        }
+        if (node.kind == FlatNode::Opaque) {
+            opaque.push_back(i);
+            continue;
+        }
+        for (usize c = w->child_count(); c-- > 0;) {
+            if (auto cw = w->child_at(c)) compile_stack.push_back({ cw, i });
+        }
+    }
+    // a subtree ends where the next sibling of its root, or of the nearest
+    // ancestor that has one, begins
+    subtree_end.assign(kind.size(), kind.size());
+    for (u32 i = 1; i < kind.size(); i++) subtree_end[i] = next_sibling[i] != NONE ? next_sibling[i] : subtree_end[parent[i]];
+    constraints.assign(kind.size(), BoxConstraints{});
+    sizes.assign(kind.size(), Size{});
+    bounds.assign(kind.size(), Rect::everything());
+}
+
+void FlatTree::layout(BoxConstraints const& ctr) {
+    if (kind.empty()) return;
+    constraints[0] = ctr;
+    stack.clear();
+    stack.push_back({ 0 });
+    while (!stack.empty()) {
+        Frame& f = stack.back();
+        u32 n = f.node;
+        BoxConstraints const c = constraints[n];
+        FlatNode const& p = params[n];
+        u32 child = child_count[n] ? n + 1 : NONE;
+        u32 push = NONE;
+        switch (kind[n]) {
+        case FlatNode::Opaque:
+            sizes[n] = widget[n]->layout(c);
+            break;
+        case FlatNode::Leaf:
+            sizes[n] = c.constrain(p.f[0], p.f[1]);
+            break;
+        case FlatNode::Pass:
+        case FlatNode::Elevate:
+        case FlatNode::Clip:
+            if (child == NONE) sizes[n] = c.smallest();
+            else if (f.stage == 0) constraints[push = child] = c;
+            else sizes[n] = sizes[child];
+            break;
+        case FlatNode::Align:
+            if (child == NONE) {
+                sizes[n] = c.smallest();
+            } else if (f.stage == 0) {
+                constraints[push = child] = c.loosen();
+            } else {
+                Size wanted = sizes[child];
+                Size size = c.constrain(wanted * Size{ p.f[2], p.f[3] });
+                positions[child] = (size - wanted) * (Position{ p.f[0], p.f[1] } + Position{ 1.0, 1.0 }) / 2.0;
+                sizes[n] = size;
+            }
+            break;
+        case FlatNode::Constrained: {
+            BoxConstraints inner = BoxConstraints{ p.f[0], p.f[1], p.f[2], p.f[3] }.enforce(c);
+            if (child == NONE) sizes[n] = inner.constrain(Size{});
+            else if (f.stage == 0) constraints[push = child] = inner;
+            else sizes[n] = sizes[child];
+            break;
+        }
+        case FlatNode::Limited: {
+            BoxConstraints inner = {
+                c.min_width,
+                c.has_bounded_width() ? c.max_width : c.constrain_width(p.f[0]),
+                c.min_height,
+                c.has_bounded_height() ? c.max_height : c.constrain_height(p.f[1]),
+            };
+            if (child == NONE) sizes[n] = inner.constrain(Size{});
+            else if (f.stage == 0) constraints[push = child] = inner;
+            else sizes[n] = c.constrain(sizes[child]);
+            break;
+        }
+        case FlatNode::Position:
+            if (child != NONE && f.stage == 0) {
+                constraints[push = child] = BoxConstraints::no_constraints();
+            } else {
+                if (child != NONE) positions[child] = Position{ p.f[0], p.f[1] };
+                sizes[n] = Size{};
+            }
+            break;
+        case FlatNode::List: {
+            u32 next = f.stage == 0 ? child : next_sibling[f.child];
+            if (next != NONE) constraints[push = next] = c;
+            else sizes[n] = c.smallest();
+            break;
+        }
+        case FlatNode::Flex:
+            push = layout_flex(f);
+            break;
+        }
+        if (push == NONE) {
+            stack.pop_back();
+            continue;
+        }
+        if (kind[n] != FlatNode::Flex) {
+            f.stage++;
+            f.child = push;
+        }
+        // leaves need no frame of their own: the parent resumes right away
+        if (kind[push] == FlatNode::Leaf) {
+            sizes[push] = constraints[push].constrain(params[push].f[0], params[push].f[1]);
+            continue;
+        }
+        stack.push_back({ push });
+    }
+    for (u32 i : opaque) widget[i]->set_render_pos(positions[i]);
+    compute_bounds();
+}
+
+// Children follow their parents, so a backward pass sees every child before
+// its parent.
+void FlatTree::compute_bounds() {
+    for (u32 i = 0; i < kind.size(); i++) {
+        switch (kind[i]) {
+        case FlatNode::Opaque: bounds[i] = widget[i]->get_paint_bounds(); break;
+        case FlatNode::Position: bounds[i] = Rect::everything(); break;
+        case FlatNode::Elevate:
+            bounds[i] = Rect::from_size(sizes[i]);
+            if (params[i].c.a != 0) bounds[i] = bounds[i].united(Elevate::shadow_bounds(sizes[i], params[i].f[0]));
+            break;
+        default: bounds[i] = Rect::from_size(sizes[i]); break;
+        }
+    }
+    for (u32 i = kind.size(); i-- > 1;) {
+        u32 p = parent[i];
+        if (kind[p] != FlatNode::Clip) bounds[p] = bounds[p].united(bounds[i].translated(positions[i]));
+    }
+}
+
+// Flex::compute_sizes and calculate_layout as a resumable step: returns the
+// next child to lay out, or NONE once the node has its size.
+u32 FlatTree::layout_flex(Frame& f) {
+    u32 n = f.node;
+    BoxConstraints const& c = constraints[n];
+    Flex::Packed s = Flex::unpack(params[n].u);
+    bool horizontal = s.direction == Axis::Horizontal;
+    bool stretch = s.cross_axis_alignment == Flex::CrossAxisStretch;
+    f32 max_main_size = horizontal ? c.max_width : c.max_height;
+    bool can_flex = max_main_size < INFINITY;
+    u32 first = child_count[n] ? n + 1 : NONE;
+    auto add_child_size = [&](u32 i) {
+        Size mc_size = horizontal ? sizes[i] : Size{ sizes[i].h, sizes[i].w };
+        f.allocated += mc_size.w;
+        f.cross = std::max(f.cross, mc_size.h);
+    };
+    switch (f.stage) {
+    case 0:
+        if (s.cross_axis_alignment == Flex::CrossAxisBaseline) {
+            sizes[n] = Size{};
+            return NONE;
+        }
+        for (u32 i = first; i != NONE; i = next_sibling[i]) {
+            if (flex[i] > 0) {
+                f.total_flex += flex[i];
+                f.last_flex = i;
+            }
+        }
+        f.stage = 1;
+        [[fallthrough]];
+    case 1: {
+        u32 i = first;
+        if (f.child != NONE) {
+            add_child_size(f.child);
+            i = next_sibling[f.child];
+        }
+        while (i != NONE && flex[i] > 0) i = next_sibling[i];
+        if (i != NONE) {
+            if (stretch) constraints[i] = horizontal ? BoxConstraints::tight_h(c.max_height) : BoxConstraints::tight_w(c.max_width);
+            else constraints[i] = horizontal ? BoxConstraints{ 0.0, INFINITY, 0.0, c.max_height } : BoxConstraints{ 0.0, c.max_width, 0.0, INFINITY };
+            f.child = i;
+            return i;
+        }
+        f.free_space = std::max(0.f, (can_flex ? max_main_size : 0.f) - f.allocated);
+        f.stage = 2;
+        f.child = NONE;
+        [[fallthrough]];
+    }
+    case 2: {
+        f32 space_per_flex = (can_flex && f.total_flex > 0) ? f.free_space / f.total_flex : NAN;
+        auto max_extent = [&](u32 i) {
+            if (!can_flex) return f32(INFINITY);
+            return i == f.last_flex ? f.free_space - f.allocated_flex : space_per_flex * flex[i];
+        };
+        u32 i = f.last_flex == NONE ? NONE : first;
+        if (f.child != NONE) {
+            add_child_size(f.child);
+            f.allocated_flex += max_extent(f.child);
+            i = next_sibling[f.child];
+        }
+        while (i != NONE && !(flex[i] > 0)) i = next_sibling[i];
+        if (i != NONE) {
+            f32 max_child_extent = max_extent(i);
+            f32 min_child_extent = fit[i] == Flex::FitTight ? max_child_extent : 0.f;
+            if (stretch) {
+                constraints[i] = horizontal ?
+                    BoxConstraints{ min_child_extent, max_child_extent, c.max_height, c.max_height } :
+                    BoxConstraints{ c.max_width, c.max_width, min_child_extent, max_child_extent };
+            } else {
+                constraints[i] = horizontal ?
+                    BoxConstraints{ min_child_extent, max_child_extent, 0.0, c.max_height } :
+                    BoxConstraints{ 0.0, c.max_width, min_child_extent, max_child_extent };
+            }
+            f.child = i;
+            return i;
+        }
+        f32 ideal_size = (can_flex && s.main_axis_size == Flex::MainAxisMax) ? max_main_size : f.allocated;
+        Size new_size = c.constrain(horizontal ? Size{ ideal_size, f.cross } : Size{ f.cross, ideal_size });
+        sizes[n] = new_size;
+        if (horizontal) position_flex(n, new_size.w, new_size.h);
+        else position_flex(n, new_size.h, new_size.w);
+        return NONE;
+    }
+    }
+    return NONE;
+}
+
+// Flex::position_children over the sibling chain.
+void FlatTree::position_flex(u32 n, f32 main_size, f32 cross_size) {
+    Flex::Packed s = Flex::unpack(params[n].u);
+    bool horizontal = s.direction == Axis::Horizontal;
+    u32 first = child_count[n] ? n + 1 : NONE;
+    f32 used = 0.f;
+    for (u32 i = first; i != NONE; i = next_sibling[i]) used += horizontal ? sizes[i].w : sizes[i].h;
+    auto [before, between, _] = Flex::distribute_free_space(s.main_axis_alignment, main_size - used, child_count[n]);
+    bool backwards = (horizontal && s.text_direction == TextDirection::RTL) || (!horizontal && s.vertical_direction == VerticalDirection::Up);
+    bool cross_backwards = (!horizontal && s.text_direction == TextDirection::RTL) || (horizontal && s.vertical_direction == VerticalDirection::Up);
+    f32 pos_here = before;
+    for (u32 i = first; i != NONE; i = next_sibling[i]) {
+        Size m_c = horizontal ? sizes[i] : Size{ sizes[i].h, sizes[i].w };
+        if (i != first) pos_here += between;
+        Size c_size = { pos_here, Flex::get_cross_offset(s.cross_axis_alignment, cross_size, m_c.h) };
+        pos_here += m_c.w;
+        if (cross_backwards) c_size.h = cross_size - c_size.h;
+        if (backwards) c_size.w = main_size - c_size.w - m_c.w;
+        positions[i] = horizontal ? c_size : Size{ c_size.h, c_size.w };
+    }
+}
+
+// Parents precede their children, so a single forward pass can hand every
+// node the origin, z and clip rect its parent's render would have given it.
+// ctx.clip follows the node being painted and is restored at the end.
+void FlatTree::paint(RenderContext& ctx) {
+    usize n = kind.size();
+    child_origin.resize(n);
+    child_z.resize(n);
+    child_clip.resize(n);
+    clips.assign(1, ctx.clip);
+    u32 active = 0;
+    for (u32 i = 0; i < n; i++) {
+        u32 p = parent[i];
+        Position origin = p == NONE ? ctx.pos : child_origin[p];
+        f32 z = p == NONE ? ctx.z : child_z[p];
+        u32 clip = p == NONE ? 0 : child_clip[p];
+        if (clip != active) ctx.clip = clips[active = clip];
+        child_clip[i] = clip;
+        if (!ctx.clip.intersects(bounds[i].translated(origin + positions[i]))) {
+            if (ctx.b) ctx.b->count_culled(subtree_end[i] - i);
+            i = subtree_end[i] - 1;
+            continue;
+        }
+        switch (kind[i]) {
+        case FlatNode::Opaque: {
+            RenderContext sub = ctx;
+            sub.pos = origin;
+            sub.z = z;
+            widget[i]->paint(sub);
+            break;
+        }
+        case FlatNode::Leaf: {
+            Position pos = origin + positions[i];
+            f32 radius = params[i].f[2], border = params[i].f[3];
+            if (radius > 0.f || border > 0.f) ctx.draw_border(pos.x, pos.y, sizes[i].w, sizes[i].h, radius, border, params[i].c, z);
+            else ctx.draw_rectangle(pos.x, pos.y, sizes[i].w, sizes[i].h, params[i].c, z);
+            break;
+        }
+        case FlatNode::Position:
+            child_origin[i] = params[i].u ? Position{} : positions[i];
+            child_z[i] = z;
+            break;
+        case FlatNode::Elevate: {
+            RenderContext sub = ctx;
+            sub.z = z;
+            Elevate::paint_shadow(sub, origin + positions[i], sizes[i], params[i].f[0], params[i].f[1], params[i].c);
+            child_origin[i] = origin + positions[i];
+            child_z[i] = z + params[i].f[0];
+            break;
+        }
+        case FlatNode::Clip:
+            child_origin[i] = origin + positions[i];
+            child_z[i] = z;
+            child_clip[i] = clips.size();
+            clips.push_back(ctx.clip.intersected(Rect::from_pos_size(origin + positions[i], sizes[i])));
+            break;
+        default:
+            child_origin[i] = origin + positions[i];
+            child_z[i] = z;
+            break;
+        }
+    }
+    ctx.clip = clips[0];
+}
+
+void FlatTree::write_back() {
+    for (u32 i = 0; i < kind.size(); i++) {
+        widget[i]->set_render_size(sizes[i]);
+        widget[i]->set_render_pos(positions[i]);
+        widget[i]->set_paint_bounds(bounds[i]);
+    }
+}
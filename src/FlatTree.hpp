@@ -0,0 +1,74 @@
+#ifndef FLATTREE_H_
+#define FLATTREE_H_
+
+#include "RenderContext.hpp"
+#include "Widget.hpp"
+#include <vector>
+
+// Optional layout engine for large trees. compile() lowers a widget tree
+// (see Widget::lower) into flat arrays in pre-order, so a node's subtree
+// directly follows it; layout() and paint() then run as loops over those
+// arrays with an explicit stack instead of recursive virtual calls, and
+// produce the same sizes, positions and rectangles as the widgets would.
+//
+// The flat tree is a snapshot: it must be compiled again after the widget
+// tree changes. Opaque widgets are kept as single nodes and still lay out
+// and paint their subtree through their own virtuals.
+class FlatTree {
+public:
+    static constexpr u32 NONE = ~0u;
+    void compile(Widget* root);
+    void layout(BoxConstraints const& ctr);
+    void paint(RenderContext& ctx);
+    // Copies sizes, positions and paint bounds into the widgets, e.g. for hit
+    // testing.
+    void write_back();
+    usize size() const { return kind.size(); }
+    Widget* widget_at(u32 i) const { return widget[i]; }
+    Size size_at(u32 i) const { return sizes[i]; }
+    Position pos_at(u32 i) const { return positions[i]; }
+private:
+    std::vector<FlatNode::Kind> kind;
+    std::vector<u32> next_sibling;
+    std::vector<u32> child_count;
+    std::vector<FlatNode> params;
+    std::vector<i32> flex;
+    std::vector<u8> fit;
+    std::vector<Widget*> widget;
+    std::vector<u32> opaque;
+    // one past the last node of each subtree
+    std::vector<u32> subtree_end;
+
+    std::vector<BoxConstraints> constraints;
+    std::vector<Size> sizes;
+    std::vector<Position> positions;
+    // as Widget::compute_paint_bounds
+    std::vector<Rect> bounds;
+
+    // paint: origin, z and clip rect (an index in clips) each node passes to
+    // its children
+    std::vector<u32> parent;
+    std::vector<Position> child_origin;
+    std::vector<f32> child_z;
+    std::vector<u32> child_clip;
+    std::vector<Rect> clips;
+
+    struct Frame {
+        u32 node;
+        u32 stage = 0;
+        u32 child = NONE;
+        u32 last_flex = NONE;
+        f32 allocated = 0;
+        f32 cross = 0;
+        f32 total_flex = 0;
+        f32 free_space = 0;
+        f32 allocated_flex = 0;
+    };
+    std::vector<Frame> stack;
+    std::vector<std::pair<Widget*, u32>> compile_stack;
+    u32 layout_flex(Frame& f);
+    void position_flex(u32 n, f32 main_size, f32 cross_size);
+    void compute_bounds();
+};
+
+#endif // FLATTREE_H_
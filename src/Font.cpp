@@ -0,0 +1,379 @@
+#include "Font.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <string>
+
+namespace {
+
+// Polylines of the printable ASCII glyphs, from 32 to 126; NOTDEF is drawn
+// for any other code point. Points are two digits, x in [0, 4] and y in
+// [0, 8]: capitals span 0 to 6 (the baseline), lowercase letters start at 2
+// and descenders reach 8. Polylines are separated by spaces; a single point
+// is a dot.
+const char* const GLYPHS[95] = {
+    "", "2024 26", "1011 3031", "1016 3036 0242 0444", "413010010213334445361605 2026", "4006 0001 4546",
+    "4612112031320405162644", "2021", "30111536", "10313516", "1133 1331 2024", "1333 2224", "2617", "1333", "26",
+    "4006",
+    "103041453616050110 3115", "1120 2026 1636", "01103041420646", "0110304142334445361605 1333", "300444 3036",
+    "400002324345361605", "3010010516364543321203", "00404116", "103041423313020110 1304051636454433",
+    "1636454130100103143443",
+    "22 26", "22 2617", "410345", "0242 0444", "014305", "01103041422324 26", "3222132434 32344441301001051646",
+    "062046 1333", "00063645443303 3342413000", "4130100105163645", "00304145360600", "40000646 0333",
+    "400006 0333", "41301001051636454323", "0006 4046 0343", "1030 2026 1636", "2040 3035261605",
+    "0006 4004 1346", "000646", "0600234046", "06004640", "103041453616050110", "06003041423303",
+    "103041453616050110 2446", "06003041423303 2346", "413010010213334445361605", "0040 2026",
+    "000516364540", "002640", "0016233640", "0046 4006", "002340 2326", "00400646",
+    "30101636", "0046", "10303616", "122032", "0747", "1021",
+    "12324346 441405163645", "0006 0312324345361605", "4332120305163645", "4046 4332120305163645",
+    "04444332120305163645", "40201116 0232", "4332120304153544 4247381807", "0006 0312324346", "2226 20",
+    "3237281807 30", "0006 4205 1446", "10202536", "0602 03122326 23324346", "0602 0312324346",
+    "123243453616050312", "0208 0312324345361605", "4248 4332120305163645", "0206 04223243",
+    "43321203143445361605", "10152636 0232", "0205163645 4246", "022642", "0216233642", "0246 4206",
+    "0226 421808", "02420646",
+    "30212213242536", "2028", "10212233242516", "03123443",
+};
+const char* const NOTDEF = "0040460600";
+
+struct Outline {
+    std::vector<std::vector<Position>> strokes;
+    // horizontal extent in grid units
+    f32 x0 = 0.f, x1 = 0.f;
+};
+
+Outline parse_outline(const char* s, bool digit) {
+    Outline o;
+    o.x0 = INFINITY, o.x1 = -INFINITY;
+    std::vector<Position> stroke;
+    for (const char* p = s; ; p++) {
+        if (*p == ' ' || *p == 0) {
+            if (!stroke.empty()) o.strokes.push_back(std::move(stroke));
+            stroke.clear();
+            if (*p == 0) break;
+            continue;
+        }
+        Position pt(p[0] - '0', p[1] - '0');
+        o.x0 = std::min(o.x0, pt.x);
+        o.x1 = std::max(o.x1, pt.x);
+        stroke.push_back(pt);
+        p++;
+    }
+    // digits are tabular; a space is as wide as a narrow letter
+    if (digit) o.x0 = 0.f, o.x1 = 4.f;
+    if (o.strokes.empty()) o.x0 = 0.f, o.x1 = 1.5f;
+    return o;
+}
+
+Outline const& outline(u32 codepoint) {
+    static std::vector<Outline> const table = [] {
+        std::vector<Outline> t;
+        for (u32 c = 32; c < 127; c++) t.push_back(parse_outline(GLYPHS[c - 32], c >= '0' && c <= '9'));
+        t.push_back(parse_outline(NOTDEF, false));
+        return t;
+    }();
+    return table[codepoint >= 32 && codepoint < 127 ? codepoint - 32 : 95];
+}
+
+// Sizes are kept in eighths of a pixel, so equal fonts have equal keys.
+u32 font_key(Font f) { return u32(std::lround(std::clamp(f.size, 0.f, 65535.f) * 8.f)) << 1 | u32(f.bold); }
+f32 font_size(u32 key) { return f32(key >> 1) / 8.f; }
+
+struct Metrics {
+    f32 unit;   // one grid step
+    f32 top;    // grid row 0 below the top of the line box
+    f32 side;   // space left and right of the outline
+    f32 radius; // half the stroke width
+};
+
+Metrics metrics(u32 key) {
+    f32 size = font_size(key);
+    return { size / 8.f, size / 8.f, size / 8.f, std::max(0.4f, size * (key & 1 ? 0.075f : 0.045f)) };
+}
+
+f32 advance(Outline const& o, Metrics const& m) { return (o.x1 - o.x0) * m.unit + 2.f * m.side; }
+
+f32 segment_distance(Position p, Position a, Position b) {
+    Position ab = b - a, ap = p - a;
+    f32 len = ab.x * ab.x + ab.y * ab.y;
+    f32 t = len > 0.f ? std::clamp((ap.x * ab.x + ap.y * ab.y) / len, 0.f, 1.f) : 0.f;
+    Position d = ap - ab * t;
+    return std::sqrt(d.x * d.x + d.y * d.y);
+}
+
+struct Bitmap {
+    u32 w = 0, h = 0;
+    i32 dx = 0, dy = 0;
+    std::vector<u8> pixels;
+};
+
+// Coverage of the strokes at each pixel center: a pixel is covered as far as
+// the stroke edge is more than half a pixel past it.
+void rasterize(u32 codepoint, u32 key, Bitmap& out) {
+    Outline const& o = outline(codepoint);
+    Metrics m = metrics(key);
+    out.w = out.h = 0;
+    if (o.strokes.empty()) return;
+    std::vector<std::vector<Position>> strokes = o.strokes;
+    f32 x0 = INFINITY, y0 = INFINITY, x1 = -INFINITY, y1 = -INFINITY;
+    for (auto& s : strokes) {
+        for (auto& p : s) {
+            p = Position(m.side + (p.x - o.x0) * m.unit, m.top + p.y * m.unit);
+            x0 = std::min(x0, p.x), x1 = std::max(x1, p.x);
+            y0 = std::min(y0, p.y), y1 = std::max(y1, p.y);
+        }
+    }
+    f32 reach = m.radius + 0.5f;
+    out.dx = i32(std::floor(x0 - reach)), out.dy = i32(std::floor(y0 - reach));
+    out.w = u32(std::ceil(x1 + reach) - out.dx), out.h = u32(std::ceil(y1 + reach) - out.dy);
+    out.pixels.assign(usize(out.w) * out.h, 0);
+    for (u32 y = 0; y < out.h; y++) {
+        for (u32 x = 0; x < out.w; x++) {
+            Position c(out.dx + x + 0.5f, out.dy + y + 0.5f);
+            f32 d = INFINITY;
+            for (auto const& s : strokes) {
+                if (s.size() == 1) d = std::min(d, segment_distance(c, s[0], s[0]));
+                for (usize i = 1; i < s.size(); i++) d = std::min(d, segment_distance(c, s[i - 1], s[i]));
+            }
+            out.pixels[usize(y) * out.w + x] = u8(std::lround(std::clamp(reach - d, 0.f, 1.f) * 255.f));
+        }
+    }
+}
+
+u32 decode_utf8(std::string_view s, usize& i) {
+    u8 c = s[i++];
+    if (c < 0x80) return c;
+    u32 extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+    if (extra == 0 || c >= 0xf8) return 0xfffd;
+    u32 cp = c & (0x3f >> extra);
+    for (u32 k = 0; k < extra; k++) {
+        if (i >= s.size() || (u8(s[i]) & 0xc0) != 0x80) return 0xfffd;
+        cp = cp << 6 | (u8(s[i++]) & 0x3f);
+    }
+    return cp;
+}
+
+std::shared_ptr<TextRun const> shape(std::string_view text, Font font) {
+    auto run = std::make_shared<TextRun>();
+    u32 key = font_key(font);
+    Metrics m = metrics(key);
+    run->font = font;
+    f32 pen = 0.f;
+    for (usize i = 0; i < text.size();) {
+        u32 cp = decode_utf8(text, i);
+        run->glyphs.push_back(cp);
+        run->x.push_back(pen);
+        pen += advance(outline(cp), m);
+    }
+    run->size = Size(pen, font_size(key) * 1.25f);
+    return run;
+}
+
+// Recently shaped runs, keyed by the text followed by the font key.
+constexpr usize RUN_CACHE_SIZE = 8192;
+using RunList = std::list<std::pair<std::string, std::shared_ptr<TextRun const>>>;
+std::mutex run_mutex;
+RunList run_list;
+std::unordered_map<std::string_view, RunList::iterator> run_index;
+
+} // namespace
+
+std::shared_ptr<TextRun const> shape_text(std::string_view text, Font font) {
+    thread_local std::string key;
+    u32 fk = font_key(font);
+    key.assign(text);
+    key.append(reinterpret_cast<const char*>(&fk), sizeof(fk));
+    {
+        std::lock_guard lock(run_mutex);
+        auto it = run_index.find(key);
+        if (it != run_index.end()) {
+            run_list.splice(run_list.begin(), run_list, it->second);
+            return it->second->second;
+        }
+    }
+    auto run = shape(text, font);
+    std::lock_guard lock(run_mutex);
+    // another thread may have added it meanwhile
+    if (run_index.count(key)) return run;
+    run_list.emplace_front(key, run);
+    run_index.emplace(run_list.front().first, run_list.begin());
+    if (run_list.size() > RUN_CACHE_SIZE) {
+        run_index.erase(run_list.back().first);
+        run_list.pop_back();
+    }
+    return run;
+}
+
+GlyphAtlas::GlyphAtlas(u32 w, u32 h) : w(w), h(h), pixels(usize(w) * h, 0) {}
+
+void GlyphAtlas::begin_frame() {
+    frame++;
+}
+
+GlyphAtlas::Glyph const* GlyphAtlas::get(u32 codepoint, Font font) {
+    u32 e = find(codepoint, font);
+    return e == NONE ? nullptr : &entries[e].g;
+}
+
+GlyphAtlas::Page& GlyphAtlas::page(u32 fk) {
+    for (auto& p : pages) {
+        if (p.font == fk) return p;
+    }
+    Page& p = pages.emplace_back();
+    p.font = fk;
+    std::fill(std::begin(p.entries), std::end(p.entries), NONE);
+    return p;
+}
+
+// Looks a glyph up, adding it if needed, and marks its shelf as used.
+u32 GlyphAtlas::find(u32 codepoint, Font font) {
+    u32 fk = font_key(font);
+    u64 key = u64(fk) << 32 | codepoint;
+    Page* page = codepoint < 128 ? &this->page(fk) : nullptr;
+    u32 e = page ? page->entries[codepoint] : NONE;
+    if (e == NONE) {
+        auto it = index.find(key);
+        e = it != index.end() ? it->second : add(key, codepoint);
+        if (e == NONE) return NONE;
+        if (page) page->entries[codepoint] = e;
+    }
+    if (entries[e].shelf != NONE) shelves[entries[e].shelf].used = frame;
+    return e;
+}
+
+u32 GlyphAtlas::add(u64 key, u32 codepoint) {
+    PROFILE_ZONE("rasterize glyph");
+    static thread_local Bitmap bm;
+    rasterize(codepoint, u32(key >> 32), bm);
+    Entry entry{ { 0, 0, 0, 0, i16(bm.dx), i16(bm.dy) }, key, NONE };
+    if (bm.w > 0) {
+        u32 s = place(bm.w, bm.h);
+        if (s == NONE) return NONE;
+        Shelf& shelf = shelves[s];
+        entry.g.u = shelf.x, entry.g.v = shelf.y;
+        entry.g.w = bm.w, entry.g.h = bm.h;
+        entry.shelf = s;
+        shelf.x += bm.w + 1;
+        for (u32 y = 0; y < bm.h; y++) std::copy_n(bm.pixels.data() + usize(y) * bm.w, bm.w, pixels.data() + usize(entry.g.v + y) * w + entry.g.u);
+        pending.push_back({ entry.g.u, entry.g.v, bm.w, bm.h });
+    }
+    u32 e;
+    if (!free_entries.empty()) {
+        e = free_entries.back();
+        free_entries.pop_back();
+        entries[e] = entry;
+    } else {
+        e = entries.size();
+        entries.push_back(entry);
+    }
+    if (entry.shelf != NONE) shelves[entry.shelf].entries.push_back(e);
+    index.emplace(key, e);
+    counters.glyphs++;
+    counters.rasterized++;
+    return e;
+}
+
+// A shelf with room for a gw x gh glyph: the lowest fitting one, a new one,
+// or the least recently used ones, emptied.
+u32 GlyphAtlas::place(u32 gw, u32 gh) {
+    // one texel apart, so no glyph touches another
+    u32 need = gh + 1, height = (need + 3) & ~3u;
+    if (gw + 1 > w) return NONE;
+    u32 best = NONE;
+    for (u32 s = 0; s < shelves.size(); s++) {
+        Shelf const& sh = shelves[s];
+        if (sh.h < need || sh.h > height + height / 2 || sh.x + gw + 1 > w) continue;
+        if (best == NONE || sh.h < shelves[best].h) best = s;
+    }
+    if (best != NONE) return best;
+    if (free_y + height <= h) {
+        shelves.push_back({ free_y, height, 0, frame, {} });
+        free_y += height;
+        return shelves.size() - 1;
+    }
+    for (u32 s = 0; s < shelves.size(); s++) {
+        Shelf const& sh = shelves[s];
+        if (sh.h < need || sh.used == frame) continue;
+        if (best == NONE || sh.used < shelves[best].used || (sh.used == shelves[best].used && sh.h < shelves[best].h)) best = s;
+    }
+    if (best != NONE) {
+        evict(best);
+        return best;
+    }
+    // none is tall enough: merge neighbours not used this frame. Shelves are
+    // in y order; the ones merged into another keep a height of 0.
+    for (u32 s = 0; s < shelves.size(); s++) {
+        u32 end = s, total = 0;
+        for (; end < shelves.size() && total < need && shelves[end].used != frame; end++) total += shelves[end].h;
+        if (total < need) continue;
+        for (u32 m = s; m < end; m++) {
+            evict(m);
+            shelves[m].h = 0;
+        }
+        shelves[s].h = total;
+        return s;
+    }
+    return NONE;
+}
+
+void GlyphAtlas::evict(u32 s) {
+    Shelf& shelf = shelves[s];
+    for (u32 e : shelf.entries) {
+        u64 key = entries[e].key;
+        index.erase(key);
+        u32 fk = u32(key >> 32), cp = u32(key);
+        if (cp < 128) {
+            for (auto& p : pages) {
+                if (p.font == fk) p.entries[cp] = NONE;
+            }
+        }
+        free_entries.push_back(e);
+    }
+    counters.glyphs -= shelf.entries.size();
+    counters.evicted_shelves++;
+    shelf.entries.clear();
+    shelf.x = 0;
+    evictions++;
+}
+
+void GlyphAtlas::draw(DrawBatch& b, TextRun const& run, Position p, f32 z, Color c, Rect const& clip) {
+    thread_local std::vector<rect_instance_t> quads;
+    quads.clear();
+    // ASCII glyphs that are in already take the page of the font
+    Page const& ascii = page(font_key(run.font));
+    f32 x = std::round(p.x), y = std::round(p.y);
+    for (usize i = 0; i < run.glyphs.size(); i++) {
+        u32 cp = run.glyphs[i];
+        u32 e = cp < 128 ? ascii.entries[cp] : NONE;
+        if (e == NONE) e = find(cp, run.font);
+        else if (entries[e].shelf != NONE) shelves[entries[e].shelf].used = frame;
+        if (e == NONE || entries[e].g.w == 0) continue;
+        Glyph const& g = entries[e].g;
+        f32 gx = std::clamp(x + std::round(run.x[i]) + g.dx, -32768.f, 32767.f);
+        f32 gy = std::clamp(y + g.dy, -32768.f, 32767.f);
+        rect_instance_t q = { i16(gx), i16(gy), i16(g.w), i16(g.h), z, c, g.u, g.v };
+        if (DrawBatch::clip_instance(q, clip)) quads.push_back(q);
+    }
+    if (quads.empty()) return;
+    std::copy(quads.begin(), quads.end(), b.claim(quads.size()));
+}
+
+void GlyphAtlas::upload(DrawBatch& b) {
+    if (uploaded_to != &b) {
+        // only the rows shelves were taken from were ever written
+        b.set_atlas_size(w, h);
+        b.write_atlas(0, 0, w, free_y, pixels.data());
+        uploaded_to = &b;
+        pending.clear();
+        return;
+    }
+    thread_local std::vector<u8> rect;
+    for (auto r : pending) {
+        rect.resize(usize(r.w) * r.h);
+        for (u32 y = 0; y < r.h; y++) std::copy_n(pixels.data() + usize(r.y + y) * w + r.x, r.w, rect.data() + usize(y) * r.w);
+        b.write_atlas(r.x, r.y, r.w, r.h, rect.data());
+    }
+    pending.clear();
+}
@@ -0,0 +1,102 @@
+#ifndef FONT_H_
+#define FONT_H_
+
+#include "DrawBatch.hpp"
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Text comes from a built-in stroke font: glyphs are polylines on a small
+// grid, rasterized with anti-aliasing on the CPU at the size they are drawn
+// at and packed into a GlyphAtlas. Digits all have the same advance, so
+// numbers that change do not move their neighbours.
+
+struct Font {
+    // line height is 1.25 size; size spans ascenders to descenders
+    f32 size = 14.f;
+    bool bold = false;
+    bool operator==(Font const&) const = default;
+};
+
+// A string laid out in a font: its code points and their pen positions from
+// the left of the line box, whose size is `size`.
+struct TextRun {
+    Font font;
+    Size size;
+    std::vector<u32> glyphs;
+    std::vector<f32> x;
+};
+
+// Shapes UTF-8 text, or returns the run cached for the same string and font.
+// The cache keeps the most recently used runs and may be called from any
+// thread, such as during parallel layout.
+std::shared_ptr<TextRun const> shape_text(std::string_view text, Font font);
+
+// Rasterized glyphs in a one-channel texture, packed in shelves (rows of
+// glyphs of similar height). When it is full, the shelf used least recently
+// is evicted, but never one drawn from since begin_frame.
+class GlyphAtlas {
+public:
+    // Texels and offset from the pen position at the top of the line box;
+    // nothing to draw when w is 0.
+    struct Glyph { u16 u, v, w, h; i16 dx, dy; };
+    struct Stats {
+        usize glyphs = 0;
+        usize rasterized = 0;
+        usize evicted_shelves = 0;
+    };
+    GlyphAtlas(u32 w = 1024, u32 h = 1024);
+    GlyphAtlas(GlyphAtlas const&) = delete;
+    GlyphAtlas& operator=(GlyphAtlas const&) = delete;
+    void begin_frame();
+    // The glyph, rasterized on first use; nullptr if it fits nowhere.
+    Glyph const* get(u32 codepoint, Font font);
+    // One textured instance per visible glyph, at the pixel grid and cropped
+    // to the clip rect.
+    void draw(DrawBatch& b, TextRun const& run, Position p, f32 z, Color c, Rect const& clip = Rect::everything());
+    // Writes the glyphs added since the last upload into the batch's atlas,
+    // or the whole atlas when it was last uploaded to another batch.
+    void upload(DrawBatch& b);
+    // Bumped when glyphs are evicted: retained layers may refer to their
+    // texels and must be recorded again.
+    u64 generation() const { return evictions; }
+    Stats const& stats() const { return counters; }
+private:
+    static constexpr u32 NONE = ~0u;
+    struct Shelf {
+        u32 y, h, x;
+        u64 used;
+        std::vector<u32> entries;
+    };
+    struct Entry {
+        Glyph g;
+        u64 key;
+        u32 shelf;
+    };
+    // entries of ASCII code points in one font, found without hashing
+    struct Page {
+        u64 font;
+        u32 entries[128];
+    };
+    u32 w, h;
+    std::vector<u8> pixels;
+    std::vector<Shelf> shelves;
+    u32 free_y = 1;
+    std::vector<Entry> entries;
+    std::vector<u32> free_entries;
+    std::unordered_map<u64, u32> index;
+    std::vector<Page> pages;
+    u64 frame = 1;
+    u64 evictions = 0;
+    std::vector<FramePacket::AtlasWrite> pending;
+    DrawBatch* uploaded_to = nullptr;
+    Stats counters;
+    Page& page(u32 font_key);
+    u32 find(u32 codepoint, Font font);
+    u32 add(u64 key, u32 codepoint);
+    u32 place(u32 gw, u32 gh);
+    void evict(u32 shelf);
+};
+
+#endif // FONT_H_
@@ -0,0 +1,99 @@
+#include "FrameScheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+i64 FrameScheduler::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+i64 FrameScheduler::sleep_until(i64 deadline, i64 spin_ns) {
+    i64 overshoot = 0;
+    i64 wake = deadline - spin_ns;
+    if (i64 now = now_ns(); wake > now) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(wake - now));
+        overshoot = std::max<i64>(0, now_ns() - wake);
+    }
+    while (now_ns() < deadline) std::this_thread::yield();
+    return overshoot;
+}
+
+template<std::size_t N>
+static i64 percentile(std::array<i64, N> const& ring, usize count, usize pct) {
+    usize n = std::min<usize>(count, N);
+    if (n == 0) return 0;
+    std::vector<i64> v(ring.begin(), ring.begin() + n);
+    auto p = v.begin() + std::min(n - 1, (n * pct) / 100);
+    std::nth_element(v.begin(), p, v.end());
+    return *p;
+}
+
+// A high percentile of recent frames rather than the mean: one slow frame in
+// twenty should not miss its deadline.
+i64 FrameScheduler::predicted_work() const {
+    return work_count ? percentile(work, work_count, 95) : period_ns;
+}
+
+void FrameScheduler::set_target_rate(f64 hz) {
+    std::lock_guard lock(mutex);
+    period_ns = hz > 0 ? i64(1e9 / hz) : 0;
+}
+
+f64 FrameScheduler::get_target_rate() const {
+    std::lock_guard lock(mutex);
+    return period_ns ? 1e9 / period_ns : 0;
+}
+
+void FrameScheduler::wait_for_next_frame() {
+    i64 start = 0;
+    if (!after_idle) {
+        std::lock_guard lock(mutex);
+        // a period further for every frame done and not presented yet
+        if (frames && period_ns) start = deadline + i64(done - frames) * period_ns - predicted_work() - MARGIN_NS;
+    }
+    if (start > now_ns()) pace(start);
+    work_start = now_ns();
+}
+
+void FrameScheduler::work_done() {
+    i64 w = now_ns() - work_start;
+    std::lock_guard lock(mutex);
+    pending[done++ % PENDING] = { w, !after_idle };
+    after_idle = false;
+}
+
+void FrameScheduler::frame_presented(i64 when, i64 execute_ns) {
+    std::lock_guard lock(mutex);
+    Pending p = pending[frames % PENDING];
+    work[work_count++ % HISTORY] = p.work + execute_ns;
+    if (p.contiguous && frames) {
+        intervals[interval_count++ % HISTORY] = when - last_present;
+        if (period_ns && when > deadline + period_ns / 2) missed++;
+        // keeps to the grid, unless vsync presented later than planned or
+        // the frame was late
+        deadline = std::max(deadline + period_ns, when + period_ns - SLACK_NS);
+    } else {
+        deadline = when + period_ns;
+    }
+    last_present = when;
+    frames++;
+}
+
+void FrameScheduler::pace(i64 until) {
+    i64 overshoot = sleep_until(until, spin_ns);
+    // keep the spin a bit longer than the sleeps tend to overshoot
+    spin_ns = std::clamp((spin_ns * 7 + overshoot * 2) / 8, i64(200'000), i64(4'000'000));
+}
+
+FrameScheduler::Stats FrameScheduler::stats() const {
+    std::lock_guard lock(mutex);
+    Stats s;
+    s.frame_p50_ms = percentile(intervals, interval_count, 50) / 1e6;
+    s.frame_p99_ms = percentile(intervals, interval_count, 99) / 1e6;
+    s.work_p50_ms = percentile(work, work_count, 50) / 1e6;
+    s.work_p99_ms = percentile(work, work_count, 99) / 1e6;
+    s.frames = frames;
+    s.missed_deadlines = missed;
+    return s;
+}
@@ -0,0 +1,84 @@
+#ifndef FRAMESCHEDULER_H_
+#define FRAMESCHEDULER_H_
+
+#include "defines.h"
+#include <array>
+#include <mutex>
+
+// Paces the frames of App::run. Deadlines for presenting frames lie on a grid
+// of the target period, which snaps to the actual present times when vsync
+// holds the swap back. The thread that swaps reports each present; a frame
+// built while others are still on their way aims for the deadline after
+// theirs. Each frame starts as late as the predicted work, building plus
+// drawing, still finishes by its deadline, so input is sampled as late as
+// possible. Waits sleep for most of the interval and spin for the last
+// stretch, whose length follows the measured sleep overshoot.
+class FrameScheduler {
+public:
+    struct Stats {
+        // present-to-present intervals of consecutive frames
+        f64 frame_p50_ms = 0;
+        f64 frame_p99_ms = 0;
+        // time to build a frame plus the time to draw it, without the waits
+        // between the two and for the swap
+        f64 work_p50_ms = 0;
+        f64 work_p99_ms = 0;
+        u64 frames = 0;
+        u64 missed_deadlines = 0;
+    };
+    FrameScheduler(f64 target_hz = 60.0) { set_target_rate(target_hz); }
+    // 0 starts every frame right away and leaves pacing to vsync.
+    void set_target_rate(f64 hz);
+    f64 get_target_rate() const;
+    // Blocks until the next frame should start, then starts timing its work.
+    void wait_for_next_frame();
+    // Marks the end of the CPU work; the frame is handed over right after.
+    void work_done();
+    // Called by the thread that swaps, for every frame in the order they
+    // were done: `when` is the time the swap returned and execute_ns how
+    // long drawing the frame took before it.
+    void frame_presented(i64 when, i64 execute_ns);
+    // Call when a frame is skipped: the next one starts without waiting and
+    // its interval is not measured.
+    void idle() { after_idle = true; }
+    Stats stats() const;
+    static i64 now_ns();
+    // Sleeps for all but spin_ns of the wait, then spins until `deadline`.
+    // Returns how far the sleep overshot its target.
+    static i64 sleep_until(i64 deadline, i64 spin_ns);
+private:
+    static constexpr usize HISTORY = 256;
+    // more than the frames that can be done and not presented yet
+    static constexpr usize PENDING = 4;
+    // safety margin on top of the predicted work
+    static constexpr i64 MARGIN_NS = 1'000'000;
+    // how late a present can be and still keep to the grid
+    static constexpr i64 SLACK_NS = 500'000;
+    struct Pending {
+        i64 work;
+        bool contiguous;
+    };
+    // The UI thread starts and finishes frames, the render thread presents
+    // them: what both touch is under the mutex.
+    mutable std::mutex mutex;
+    i64 period_ns = 0;
+    i64 last_present = 0;
+    // of the frame after the last one presented
+    i64 deadline = 0;
+    std::array<Pending, PENDING> pending{};
+    u64 done = 0;
+    u64 frames = 0;
+    u64 missed = 0;
+    std::array<i64, HISTORY> intervals{};
+    std::array<i64, HISTORY> work{};
+    usize interval_count = 0;
+    usize work_count = 0;
+    // UI thread only
+    i64 work_start = 0;
+    i64 spin_ns = 2'000'000;
+    bool after_idle = true;
+    i64 predicted_work() const;
+    void pace(i64 until);
+};
+
+#endif // FRAMESCHEDULER_H_
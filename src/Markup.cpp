@@ -0,0 +1,794 @@
+#include "Markup.hpp"
+#include "Profiler.hpp"
+#include "widgets/Align.hpp"
+#include "widgets/Blob.hpp"
+#include "widgets/Button.hpp"
+#include "widgets/ClipRect.hpp"
+#include "widgets/Constrained.hpp"
+#include "widgets/Flex.hpp"
+#include "widgets/Position.hpp"
+#include "widgets/RepaintBoundary.hpp"
+#include "widgets/Text.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Parsing
+
+namespace {
+
+bool is_name_start(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+bool is_name_char(char c) { return is_name_start(c) || is_digit(c); }
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+bool is_infinity(std::string_view s) { return s == "Inf" || s == "inf" || s == "INFINITY" || s == "Infinity"; }
+i32 hex_digit(char c) {
+    if (is_digit(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+class Parser {
+    std::string_view text;
+    usize at = 0;
+    MarkupDocument& doc;
+    std::string* error;
+    std::unordered_map<std::string_view, u32> symbol_ids;
+    // top-level <Widget "name"> definitions: index of their node
+    std::unordered_map<std::string_view, u32> definitions;
+    static constexpr u32 DEFINITION = ~0u;
+    struct Open {
+        std::string_view name;
+        u32 node;
+        // definitions: their name and where their content starts
+        std::string_view defines;
+        u32 first;
+    };
+    std::vector<Open> open;
+    bool has_root = false;
+
+    char peek(usize k = 0) const { return at + k < text.size() ? text[at + k] : '\0'; }
+    bool fail(std::string_view message) {
+        if (error) {
+            usize line = 1 + std::count(text.begin(), text.begin() + std::min<usize>(at, text.size()), '\n');
+            *error = "line " + std::to_string(line) + ": " + std::string(message);
+        }
+        return false;
+    }
+    void skip_space() { while (is_space(peek())) at++; }
+    std::string_view name() {
+        usize start = at;
+        if (is_name_start(peek())) while (is_name_char(peek())) at++;
+        return text.substr(start, at - start);
+    }
+    u32 intern(std::string_view s) {
+        auto [it, added] = symbol_ids.try_emplace(s, u32(doc.symbols.size()));
+        if (added) doc.symbols.push_back(s);
+        return it->second;
+    }
+    bool number(f32& out);
+    bool numbers(MarkupValue& v, char close);
+    bool value(MarkupValue& v);
+    bool attributes(bool& self_closing);
+    bool add_child(u32 node);
+    bool element();
+    bool close_element();
+public:
+    Parser(std::string_view text, MarkupDocument& doc, std::string* error) : text(text), doc(doc), error(error) {}
+    bool parse();
+};
+
+bool Parser::number(f32& out) {
+    bool negative = peek() == '-';
+    if (peek() == '-' || peek() == '+') at++;
+    if (is_name_start(peek())) {
+        if (!is_infinity(name())) return fail("expected a number");
+        out = negative ? -INFINITY : INFINITY;
+        return true;
+    }
+    usize digits = at;
+    while (is_digit(peek())) at++;
+    // "1." is a number, "1..2" a range
+    if (peek() == '.' && peek(1) != '.') {
+        at++;
+        while (is_digit(peek())) at++;
+    }
+    if (at == digits || (at == digits + 1 && text[digits] == '.')) return fail("expected a number");
+    // from_chars takes no '+' and no trailing '.'
+    usize end = text[at - 1] == '.' ? at - 1 : at;
+    auto [p, ec] = std::from_chars(text.data() + digits, text.data() + end, out);
+    if (ec != std::errc() || p != text.data() + end) return fail("bad number");
+    if (negative) out = -out;
+    return true;
+}
+
+// Up to four numbers separated by ',' or '..', up to `close`.
+bool Parser::numbers(MarkupValue& v, char close) {
+    while (true) {
+        skip_space();
+        if (peek() == close) {
+            at++;
+            return true;
+        }
+        if (v.count == 4) return fail("at most four numbers");
+        if (!number(v.n[v.count++])) return false;
+        skip_space();
+        if (peek() == ',') at++;
+        else if (peek() == '.' && peek(1) == '.') at += 2;
+        else if (peek() != close) return fail(std::string("expected ',', '..' or '") + close + "'");
+    }
+}
+
+bool Parser::value(MarkupValue& v) {
+    char c = peek();
+    if (c == '"') {
+        usize start = ++at;
+        while (peek() != '"') {
+            if (at >= text.size() || peek() == '\n') return fail("unterminated string");
+            at++;
+        }
+        v.kind = MarkupValue::String, v.u = start, v.count = at - start;
+        at++;
+        return true;
+    }
+    if (c == '{') {
+        at++;
+        v.kind = MarkupValue::Tuple;
+        return numbers(v, '}');
+    }
+    if (c == '0' && (peek(1) == 'x' || peek(1) == 'X')) {
+        at += 2;
+        usize start = at;
+        u32 rgba = 0;
+        for (i32 d; (d = hex_digit(peek())) >= 0; at++) rgba = rgba << 4 | d;
+        if (at - start == 6) rgba = rgba << 8 | 0xff;
+        else if (at - start != 8) return fail("colors have 6 or 8 hex digits");
+        v.kind = MarkupValue::Hex, v.u = rgba;
+        return true;
+    }
+    if (is_digit(c) || c == '-' || c == '+' || c == '.') {
+        if (!number(v.n[0])) return false;
+        v.kind = MarkupValue::Number, v.count = 1;
+        // 500x50
+        if (peek() == 'x' && (is_digit(peek(1)) || peek(1) == '.')) {
+            at++;
+            if (!number(v.n[1])) return false;
+            v.kind = MarkupValue::Tuple, v.count = 2;
+        }
+        return true;
+    }
+    if (is_name_start(c)) {
+        std::string_view n = name();
+        if (is_infinity(n)) {
+            v.kind = MarkupValue::Number, v.count = 1, v.n[0] = INFINITY;
+        } else if (peek() == '(') {
+            at++;
+            v.kind = MarkupValue::Call, v.u = intern(n);
+            return numbers(v, ')');
+        } else {
+            v.kind = MarkupValue::Name, v.u = intern(n);
+        }
+        return true;
+    }
+    return fail("expected a value");
+}
+
+bool Parser::attributes(bool& self_closing) {
+    while (true) {
+        skip_space();
+        if (peek() == '/' && peek(1) == '>') {
+            at += 2;
+            self_closing = true;
+            return true;
+        }
+        if (peek() == '>') {
+            at++;
+            self_closing = false;
+            return true;
+        }
+        if (peek() == ',') {
+            at++;
+            continue;
+        }
+        if (at >= text.size()) return fail("unexpected end of text");
+        MarkupValue v = { MarkupValue::Number, MarkupValue::NO_KEY, 0, 0, {} };
+        usize start = at;
+        std::string_view key = name();
+        if (!key.empty() && peek() == '=') {
+            at++;
+            v.key = intern(key);
+        } else {
+            at = start;
+        }
+        if (!value(v)) return false;
+        doc.value_storage.push_back(v);
+    }
+}
+
+bool Parser::add_child(u32 node) {
+    if (open.empty()) {
+        if (has_root) return fail("more than one root element");
+        has_root = true;
+        doc.root = node;
+        return true;
+    }
+    Open& parent = open.back();
+    if (parent.node == DEFINITION) {
+        if (node != parent.first) return fail("<Widget> definitions hold one element");
+    } else {
+        doc.node_storage[parent.node].child_count++;
+    }
+    return true;
+}
+
+bool Parser::element() {
+    std::string_view type = name();
+    if (type.empty()) return fail("expected an element name");
+    usize first = doc.value_storage.size();
+    bool self_closing = false;
+    if (!attributes(self_closing)) return false;
+    if (type == "Widget") {
+        std::string_view defines;
+        for (usize i = first; i < doc.value_storage.size(); i++) {
+            MarkupValue const& v = doc.value_storage[i];
+            if (v.kind == MarkupValue::String && v.key == MarkupValue::NO_KEY) defines = text.substr(v.u, v.count);
+        }
+        doc.value_storage.resize(first);
+        if (defines.empty()) return fail("<Widget> needs a name");
+        if (!self_closing) {
+            if (!open.empty()) return fail("<Widget> definitions must be at the top level");
+            open.push_back({ type, DEFINITION, defines, u32(doc.node_storage.size()) });
+            return true;
+        }
+        auto def = definitions.find(defines);
+        if (def == definitions.end()) return fail("unknown widget \"" + std::string(defines) + "\"");
+        // the values are shared with the definition
+        u32 node = doc.node_storage.size(), n = doc.node_storage[def->second].subtree_size;
+        doc.node_storage.reserve(node + n);
+        for (u32 i = 0; i < n; i++) doc.node_storage.push_back(doc.node_storage[def->second + i]);
+        return add_child(node);
+    }
+    u32 node = doc.node_storage.size();
+    doc.node_storage.push_back({ intern(type), u32(first), u32(doc.value_storage.size() - first), 0, 1 });
+    if (!add_child(node)) return false;
+    if (!self_closing) open.push_back({ type, node, {}, 0 });
+    return true;
+}
+
+bool Parser::close_element() {
+    std::string_view type = name();
+    skip_space();
+    if (peek() != '>') return fail("expected '>'");
+    at++;
+    if (open.empty() || open.back().name != type) return fail("unexpected </" + std::string(type) + ">");
+    Open o = open.back();
+    open.pop_back();
+    if (o.node == DEFINITION) {
+        if (o.first == doc.node_storage.size()) return fail("<Widget> definitions hold one element");
+        definitions[o.defines] = o.first;
+    } else {
+        doc.node_storage[o.node].subtree_size = doc.node_storage.size() - o.node;
+    }
+    return true;
+}
+
+bool Parser::parse() {
+    doc.strings = text;
+    while (true) {
+        skip_space();
+        if (at >= text.size()) break;
+        if (text.substr(at, 4) == "<!--") {
+            usize end = text.find("-->", at + 4);
+            if (end == std::string_view::npos) return fail("unterminated comment");
+            at = end + 3;
+            continue;
+        }
+        if (peek() != '<') return fail("expected an element");
+        at++;
+        if (peek() == '/') {
+            at++;
+            if (!close_element()) return false;
+        } else if (!element()) {
+            return false;
+        }
+    }
+    if (!open.empty()) return fail("<" + std::string(open.back().name) + "> is not closed");
+    if (!has_root) return fail("no root element");
+    doc.nodes = doc.node_storage;
+    doc.values = doc.value_storage;
+    return true;
+}
+
+} // namespace
+
+bool parse_markup(std::string_view text, MarkupDocument& doc, std::string* error) {
+    PROFILE_ZONE("parse markup");
+    return Parser(text, doc, error).parse();
+}
+
+// Compiled images: a header, the symbol offsets and characters, the nodes of
+// the root subtree, the values and the string data, each 4-byte aligned, in
+// the byte order of the machine that compiled them.
+
+namespace {
+
+struct ImageHeader {
+    char magic[4];
+    u32 version;
+    u32 symbol_count;
+    u32 symbol_bytes;
+    u32 node_count;
+    u32 value_count;
+    u32 string_bytes;
+};
+
+constexpr char IMAGE_MAGIC[4] = { 'U', 'I', 'M', 'B' };
+constexpr u32 IMAGE_VERSION = 1;
+
+usize align4(usize n) { return (n + 3) & ~usize(3); }
+
+template<typename T>
+void append(std::vector<u8>& out, T const* p, usize n) {
+    out.insert(out.end(), reinterpret_cast<u8 const*>(p), reinterpret_cast<u8 const*>(p + n));
+    out.resize(align4(out.size()));
+}
+
+} // namespace
+
+bool is_compiled_markup(std::span<u8 const> data) {
+    return data.size() >= sizeof(ImageHeader) && !memcmp(data.data(), IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+}
+
+std::vector<u8> compile_markup(MarkupDocument const& doc) {
+    std::vector<u32> symbol_offsets = { 0 };
+    std::string symbol_chars;
+    for (auto s : doc.symbols) {
+        symbol_chars += s;
+        symbol_offsets.push_back(symbol_chars.size());
+    }
+    auto nodes = doc.nodes.subspan(doc.root, doc.nodes[doc.root].subtree_size);
+    // strings move into the image, in value order
+    std::vector<MarkupValue> values(doc.values.begin(), doc.values.end());
+    std::string strings;
+    for (auto& v : values) {
+        if (v.kind != MarkupValue::String) continue;
+        std::string_view s = doc.strings.substr(v.u, v.count);
+        v.u = strings.size();
+        strings += s;
+    }
+    ImageHeader h;
+    memcpy(h.magic, IMAGE_MAGIC, sizeof(h.magic));
+    h.version = IMAGE_VERSION;
+    h.symbol_count = doc.symbols.size();
+    h.symbol_bytes = symbol_chars.size();
+    h.node_count = nodes.size();
+    h.value_count = values.size();
+    h.string_bytes = strings.size();
+    std::vector<u8> out;
+    append(out, &h, 1);
+    append(out, symbol_offsets.data(), symbol_offsets.size());
+    append(out, symbol_chars.data(), symbol_chars.size());
+    append(out, nodes.data(), nodes.size());
+    append(out, values.data(), values.size());
+    append(out, strings.data(), strings.size());
+    return out;
+}
+
+bool read_compiled_markup(std::span<u8 const> image, MarkupDocument& doc, std::string* error) {
+    auto fail = [&](const char* message) {
+        if (error) *error = message;
+        return false;
+    };
+    if (!is_compiled_markup(image)) return fail("not a compiled screen");
+    if (reinterpret_cast<uintptr_t>(image.data()) % 4) return fail("compiled screen is not 4-byte aligned");
+    ImageHeader h;
+    memcpy(&h, image.data(), sizeof(h));
+    if (h.version != IMAGE_VERSION) return fail("compiled screen has another version");
+    // sections, in 64 bits so no count can overflow
+    u64 offsets_at = align4(sizeof(h));
+    u64 chars_at = offsets_at + (u64(h.symbol_count) + 1) * sizeof(u32);
+    u64 nodes_at = chars_at + align4(h.symbol_bytes);
+    u64 values_at = nodes_at + u64(h.node_count) * sizeof(MarkupNode);
+    u64 strings_at = values_at + u64(h.value_count) * sizeof(MarkupValue);
+    if (strings_at + h.string_bytes > image.size() || h.node_count == 0) return fail("compiled screen is truncated");
+    auto at = [&](u64 offset) { return image.data() + offset; };
+    u32 const* offsets = reinterpret_cast<u32 const*>(at(offsets_at));
+    doc.symbols.resize(h.symbol_count);
+    for (u32 i = 0; i < h.symbol_count; i++) {
+        if (offsets[i] > offsets[i + 1] || offsets[i + 1] > h.symbol_bytes) return fail("compiled screen has bad symbols");
+        doc.symbols[i] = std::string_view(reinterpret_cast<const char*>(at(chars_at)) + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    doc.nodes = { reinterpret_cast<MarkupNode const*>(at(nodes_at)), h.node_count };
+    doc.values = { reinterpret_cast<MarkupValue const*>(at(values_at)), h.value_count };
+    doc.strings = { reinterpret_cast<const char*>(at(strings_at)), h.string_bytes };
+    doc.root = 0;
+    return true;
+}
+
+// Building
+
+MarkupValue const* MarkupArgs::at(usize i) const {
+    for (auto& v : values) {
+        if (v.key == MarkupValue::NO_KEY && i-- == 0) return &v;
+    }
+    return nullptr;
+}
+
+MarkupValue const* MarkupArgs::get(u32 key) const {
+    for (auto& v : values) {
+        if (v.key < remap.size() && remap[v.key] == key) return &v;
+    }
+    return nullptr;
+}
+
+u32 MarkupArgs::symbol(MarkupValue const& v) const {
+    if (v.kind != MarkupValue::Name && v.kind != MarkupValue::Call) return WidgetRegistry::NONE;
+    return v.u < remap.size() ? remap[v.u] : WidgetRegistry::NONE;
+}
+
+std::string_view MarkupArgs::string(MarkupValue const& v) const {
+    if (v.kind != MarkupValue::String || v.u > doc.strings.size() || v.count > doc.strings.size() - v.u) return {};
+    return doc.strings.substr(v.u, v.count);
+}
+
+Widget* MarkupArgs::fail(std::string_view message) const {
+    if (error) *error = message;
+    return nullptr;
+}
+
+class MarkupBuilder {
+    MarkupDocument const& doc;
+    WidgetRegistry const& reg;
+    std::string* error;
+    std::string message;
+    // document symbol -> registry symbol
+    std::vector<u32> remap;
+    // children of the elements being built
+    std::vector<std::unique_ptr<Widget>> built;
+    std::unique_ptr<Widget> fail(std::string m) {
+        if (error) *error = std::move(m);
+        return nullptr;
+    }
+public:
+    MarkupBuilder(MarkupDocument const& doc, WidgetRegistry const& reg, std::string* error) : doc(doc), reg(reg), error(error) {
+        remap.reserve(doc.symbols.size());
+        for (auto s : doc.symbols) remap.push_back(reg.find(s));
+    }
+    // Builds node i, whose subtree must end before `end`.
+    std::unique_ptr<Widget> build(u32 i, u32 end) {
+        MarkupNode const& n = doc.nodes[i];
+        if (n.subtree_size == 0 || n.subtree_size > end - i || n.type >= remap.size() || n.first_value > doc.values.size() || n.value_count > doc.values.size() - n.first_value) {
+            return fail("corrupt screen");
+        }
+        WidgetRegistry::Factory const* f = reg.factory(remap[n.type]);
+        if (!f) return fail("unknown widget type <" + std::string(doc.symbols[n.type]) + ">");
+        usize base = built.size();
+        u32 c = i + 1;
+        for (u32 k = 0; k < n.child_count; k++) {
+            auto w = c < i + n.subtree_size ? build(c, i + n.subtree_size) : fail("corrupt screen");
+            if (!w) {
+                built.resize(base);
+                return nullptr;
+            }
+            built.push_back(std::move(w));
+            c += doc.nodes[c].subtree_size;
+        }
+        if (c != i + n.subtree_size) {
+            built.resize(base);
+            return fail("corrupt screen");
+        }
+        MarkupArgs args(doc, remap, &message);
+        args.values = doc.values.subspan(n.first_value, n.value_count);
+        args.children = std::span(built.data() + base, built.size() - base);
+        std::unique_ptr<Widget> w((*f)(args));
+        built.resize(base);
+        if (!w) return fail("<" + std::string(doc.symbols[n.type]) + ">: " + (message.empty() ? "not created" : message));
+        return w;
+    }
+};
+
+std::unique_ptr<Widget> build_markup(MarkupDocument const& doc, WidgetRegistry const& reg, std::string* error) {
+    PROFILE_ZONE("build markup");
+    if (doc.root >= doc.nodes.size()) return nullptr;
+    return MarkupBuilder(doc, reg, error).build(doc.root, doc.nodes.size());
+}
+
+namespace {
+
+// Read-only view of a whole file, mapped where the platform allows it.
+class MappedFile {
+    u8 const* data = nullptr;
+    usize size = 0;
+    std::vector<u32> copy;
+public:
+    MappedFile(const char* path) {
+#if !defined(_WIN32)
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) data = static_cast<u8 const*>(p), size = st.st_size;
+        }
+        close(fd);
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return;
+        std::string s((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        copy.resize(align4(s.size()) / 4);
+        memcpy(copy.data(), s.data(), s.size());
+        data = reinterpret_cast<u8 const*>(copy.data()), size = s.size();
+#endif
+    }
+    ~MappedFile() {
+#if !defined(_WIN32)
+        if (data) munmap(const_cast<u8*>(data), size);
+#endif
+    }
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+    std::span<u8 const> bytes() const { return { data, size }; }
+};
+
+} // namespace
+
+std::unique_ptr<Widget> load_screen(const char* path, WidgetRegistry const& reg, std::string* error) {
+    PROFILE_ZONE("load screen");
+    MappedFile file(path);
+    if (file.bytes().empty()) {
+        if (error) *error = "cannot read the file";
+        return nullptr;
+    }
+    MarkupDocument doc;
+    if (is_compiled_markup(file.bytes())) {
+        if (!read_compiled_markup(file.bytes(), doc, error)) return nullptr;
+    } else if (!parse_markup(std::string_view(reinterpret_cast<const char*>(file.bytes().data()), file.bytes().size()), doc, error)) {
+        return nullptr;
+    }
+    return build_markup(doc, reg, error);
+}
+
+// Registry
+
+u32 WidgetRegistry::symbol(std::string_view name) {
+    auto [it, added] = ids.try_emplace(std::string(name), u32(names.size()));
+    if (added) names.emplace_back(name);
+    return it->second;
+}
+
+u32 WidgetRegistry::find(std::string_view name) const {
+    auto it = ids.find(std::string(name));
+    return it == ids.end() ? NONE : it->second;
+}
+
+void WidgetRegistry::add(std::string_view type, Factory f) {
+    u32 s = symbol(type);
+    if (factories.size() <= s) factories.resize(s + 1);
+    factories[s] = std::move(f);
+}
+
+namespace {
+
+bool get_number(MarkupValue const* v, f32& out) {
+    if (!v || v->kind != MarkupValue::Number) return false;
+    out = v->n[0];
+    return true;
+}
+
+bool get_size(MarkupValue const* v, Size& out) {
+    if (!v || v->kind != MarkupValue::Tuple || v->count != 2) return false;
+    out = { v->n[0], v->n[1] };
+    return true;
+}
+
+bool get_color(MarkupValue const* v, Color& out) {
+    if (v && v->kind == MarkupValue::Hex) {
+        out = Color(v->u);
+        return true;
+    }
+    if (!v || v->kind != MarkupValue::Tuple || v->count != 4) return false;
+    out = Color(u8(v->n[0]), u8(v->n[1]), u8(v->n[2]), u8(v->n[3]));
+    return true;
+}
+
+// The only child, or nullptr.
+std::unique_ptr<Widget> only_child(MarkupArgs const& a) {
+    return a.children.size() == 1 ? std::move(a.children[0]) : nullptr;
+}
+
+template<typename E>
+struct Choice {
+    u32 symbol;
+    E value;
+};
+
+// Sets out from a Name value among the choices; false if v is another name.
+template<typename E>
+bool get_choice(MarkupArgs const& a, MarkupValue const* v, std::vector<Choice<E>> const& choices, E& out) {
+    if (!v) return true;
+    u32 s = a.symbol(*v);
+    for (auto& c : choices) {
+        if (c.symbol == s) {
+            out = c.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+WidgetRegistry const& WidgetRegistry::builtin() {
+    static WidgetRegistry const reg = [] {
+        WidgetRegistry r;
+        u32 k_size = r.symbol("size"), k_color = r.symbol("color"), k_flex = r.symbol("flex"), k_fit = r.symbol("fit");
+        u32 k_main_size = r.symbol("main_axis_size"), k_main_align = r.symbol("main_axis_alignment"), k_cross_align = r.symbol("cross_axis_alignment");
+        u32 k_alignment = r.symbol("alignment"), k_absolute = r.symbol("absolute"), k_weight = r.symbol("weight");
+        u32 k_radius = r.symbol("radius"), k_border = r.symbol("border"), k_shadow = r.symbol("shadow");
+        u32 s_tight = r.symbol("tight"), s_tight_w = r.symbol("tight_w"), s_tight_h = r.symbol("tight_h"), s_loose = r.symbol("loose");
+        std::vector<Choice<Flex::MainAxisSize>> main_sizes = { { r.symbol("min"), Flex::MainAxisMin }, { r.symbol("max"), Flex::MainAxisMax } };
+        std::vector<Choice<Flex::MainAxisAlignment>> main_aligns = {
+            { r.symbol("start"), Flex::MainAxisStart }, { r.symbol("end"), Flex::MainAxisEnd }, { r.symbol("center"), Flex::MainAxisCenter },
+            { r.symbol("space_between"), Flex::MainAxisSpaceBetween }, { r.symbol("space_around"), Flex::MainAxisSpaceAround },
+            { r.symbol("space_evenly"), Flex::MainAxisSpaceEvenly },
+        };
+        std::vector<Choice<Flex::CrossAxisAlignment>> cross_aligns = {
+            { r.symbol("start"), Flex::CrossAxisStart }, { r.symbol("end"), Flex::CrossAxisEnd },
+            { r.symbol("center"), Flex::CrossAxisCenter }, { r.symbol("stretch"), Flex::CrossAxisStretch },
+        };
+        std::vector<Choice<Flex::FlexFit>> fits = { { r.symbol("tight"), Flex::FitTight }, { r.symbol("loose"), Flex::FitLoose } };
+        std::vector<Choice<bool>> weights = { { r.symbol("normal"), false }, { r.symbol("bold"), true } };
+        std::vector<Choice<Align::Alignment>> alignments = {
+            { r.symbol("top_left"), Align::TopLeft }, { r.symbol("top_middle"), Align::TopMiddle }, { r.symbol("top_right"), Align::TopRight },
+            { r.symbol("center_left"), Align::CenterLeft }, { r.symbol("center"), Align::Center }, { r.symbol("center_right"), Align::CenterRight },
+            { r.symbol("bottom_left"), Align::BottomLeft }, { r.symbol("bottom_middle"), Align::BottomMiddle }, { r.symbol("bottom_right"), Align::BottomRight },
+        };
+
+        r.add("Blob", [=](MarkupArgs const& a) -> Widget* {
+            Size s;
+            Color c = 0u;
+            if (!get_size(a.get(k_size) ? a.get(k_size) : a.at(0), s)) return a.fail("expected a size such as 40x20");
+            f32 radius = 0, border = 0;
+            if (!get_color(a.get(k_color) ? a.get(k_color) : a.at(a.get(k_size) ? 0 : 1), c)) return a.fail("expected a color");
+            if (a.get(k_radius) && !get_number(a.get(k_radius), radius)) return a.fail("radius is a number of pixels");
+            if (a.get(k_border) && !get_number(a.get(k_border), border)) return a.fail("border is a number of pixels");
+            return (new Blob(s, c))->set_radius(radius)->set_border(border);
+        });
+        auto flex = [=](Axis axis) {
+            return [=](MarkupArgs const& a) -> Widget* {
+                Flex* f = axis == Axis::Horizontal ? static_cast<Flex*>(new Row) : new Column;
+                std::unique_ptr<Widget> owner(f);
+                Flex::MainAxisSize mas = Flex::MainAxisMax;
+                Flex::MainAxisAlignment maa = Flex::MainAxisStart;
+                Flex::CrossAxisAlignment caa = Flex::CrossAxisCenter;
+                if (!get_choice(a, a.get(k_main_size), main_sizes, mas)) return a.fail("main_axis_size is min or max");
+                if (!get_choice(a, a.get(k_main_align), main_aligns, maa)) return a.fail("unknown main_axis_alignment");
+                if (!get_choice(a, a.get(k_cross_align), cross_aligns, caa)) return a.fail("unknown cross_axis_alignment");
+                f->set_main_axis_size(mas)->set_main_axis_alignment(maa)->set_cross_axis_alignment(caa);
+                for (auto& c : a.children) f->add_child(std::move(c));
+                return owner.release();
+            };
+        };
+        r.add("Row", flex(Axis::Horizontal));
+        r.add("Column", flex(Axis::Vertical));
+        auto flexible = [=](bool expanded) {
+            return [=](MarkupArgs const& a) -> Widget* {
+                f32 factor = 1;
+                Flex::FlexFit fit = Flex::FitLoose;
+                if (a.get(k_flex) && !get_number(a.get(k_flex), factor)) return a.fail("flex is a number");
+                if (!get_choice(a, a.get(k_fit), fits, fit)) return a.fail("fit is tight or loose");
+                auto child = only_child(a);
+                if (!child) return a.fail("expected one child");
+                Flexible* f = expanded ? new Expanded(std::move(child)) : new Flexible(std::move(child), fit);
+                return f->flex(i32(factor));
+            };
+        };
+        r.add("Flexible", flexible(false));
+        r.add("Expanded", flexible(true));
+        r.add("ConstrainedBox", [=](MarkupArgs const& a) -> Widget* {
+            MarkupValue const* v = a.at(0);
+            BoxConstraints c;
+            u32 s = v ? a.symbol(*v) : NONE;
+            if (v && v->kind == MarkupValue::Tuple && v->count == 4) c = { v->n[0], v->n[1], v->n[2], v->n[3] };
+            else if (s == s_tight && v->count == 2) c = BoxConstraints::tight(v->n[0], v->n[1]);
+            else if (s == s_tight_w && v->count == 1) c = BoxConstraints::tight_w(v->n[0]);
+            else if (s == s_tight_h && v->count == 1) c = BoxConstraints::tight_h(v->n[0]);
+            else if (s == s_loose && v->count == 2) c = BoxConstraints::loose({ v->n[0], v->n[1] });
+            else return a.fail("expected constraints such as {0..100, 20..20} or tight_h(20)");
+            if (a.children.size() > 1) return a.fail("expected at most one child");
+            return new ConstrainedBox(c, only_child(a));
+        });
+        r.add("SizedBox", [=](MarkupArgs const& a) -> Widget* {
+            Size s;
+            f32 side;
+            if (get_number(a.at(0), side)) s = { side, side };
+            else if (!get_size(a.at(0), s)) return a.fail("expected a size");
+            if (a.children.size() > 1) return a.fail("expected at most one child");
+            return new SizedBox(s, only_child(a));
+        });
+        r.add("LimitedBox", [=](MarkupArgs const& a) -> Widget* {
+            Size s;
+            if (!get_size(a.at(0), s)) return a.fail("expected a size");
+            if (a.children.size() > 1) return a.fail("expected at most one child");
+            return new LimitedBox(s, only_child(a));
+        });
+        r.add("Align", [=](MarkupArgs const& a) -> Widget* {
+            Align::Alignment al = Align::Center;
+            if (!get_choice(a, a.get(k_alignment) ? a.get(k_alignment) : a.at(0), alignments, al)) return a.fail("unknown alignment");
+            auto child = only_child(a);
+            if (!child) return a.fail("expected one child");
+            return new Align(al, std::move(child));
+        });
+        r.add("Center", [=](MarkupArgs const& a) -> Widget* {
+            auto child = only_child(a);
+            if (!child) return a.fail("expected one child");
+            return new Center(std::move(child));
+        });
+        r.add("PositionBox", [=](MarkupArgs const& a) -> Widget* {
+            Position p;
+            bool absolute = false;
+            for (usize i = 0; a.at(i); i++) {
+                if (a.symbol(*a.at(i)) == k_absolute) absolute = true;
+            }
+            if (!get_size(a.at(0), p) && !(get_number(a.at(0), p.x) && get_number(a.at(1), p.y))) return a.fail("expected a position");
+            auto child = only_child(a);
+            if (!child) return a.fail("expected one child");
+            auto b = new PositionBox(p, std::move(child));
+            return absolute ? b->absolute() : b;
+        });
+        r.add("Elevate", [=](MarkupArgs const& a) -> Widget* {
+            f32 z, radius = 0;
+            Color shadow = 0u;
+            if (!get_number(a.at(0), z)) return a.fail("expected a depth");
+            if (a.get(k_radius) && !get_number(a.get(k_radius), radius)) return a.fail("radius is a number of pixels");
+            if (a.get(k_shadow) && !get_color(a.get(k_shadow), shadow)) return a.fail("expected a shadow color");
+            auto child = only_child(a);
+            if (!child) return a.fail("expected one child");
+            auto e = (new Elevate(z, std::move(child)))->set_radius(radius);
+            return a.get(k_shadow) ? e->set_shadow(shadow) : e;
+        });
+        r.add("ClipRect", [=](MarkupArgs const& a) -> Widget* {
+            auto child = only_child(a);
+            if (!child) return a.fail("expected one child");
+            return new ClipRect(std::move(child));
+        });
+        r.add("RepaintBoundary", [=](MarkupArgs const& a) -> Widget* {
+            auto child = only_child(a);
+            if (!child) return a.fail("expected one child");
+            return new RepaintBoundary(std::move(child));
+        });
+        r.add("Button", [=](MarkupArgs const& a) -> Widget* {
+            Size s;
+            if (auto child = only_child(a)) return new Button(std::move(child));
+            if (!get_size(a.at(0), s)) return a.fail("expected a size or one child");
+            return new Button(s.w, s.h);
+        });
+        r.add("Text", [=](MarkupArgs const& a) -> Widget* {
+            MarkupValue const* text = a.at(0);
+            Font font;
+            Color c = 0x000000ffu;
+            if (!text || text->kind != MarkupValue::String) return a.fail("expected the text as a string");
+            if (a.get(k_size) && !get_number(a.get(k_size), font.size)) return a.fail("size is a number of pixels");
+            if (a.get(k_color) && !get_color(a.get(k_color), c)) return a.fail("expected a color");
+            if (!get_choice(a, a.get(k_weight), weights, font.bold)) return a.fail("weight is normal or bold");
+            return new Text(a.string(*text), font, c);
+        });
+        r.add("WidgetList", [=](MarkupArgs const& a) -> Widget* {
+            auto l = new WidgetList;
+            for (auto& c : a.children) l->add_child(std::move(c));
+            return l;
+        });
+        return r;
+    }();
+    return reg;
+}
@@ -0,0 +1,130 @@
+#ifndef MARKUP_H_
+#define MARKUP_H_
+
+#include "Widget.hpp"
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Screens described in markup:
+//
+//   <Widget "Badge">
+//     <ConstrainedBox tight_h(40)><Blob 90x15 0xff0000ff /></ConstrainedBox>
+//   </Widget>
+//   <Column main_axis_size=min>
+//     <Expanded flex=2><Blob size={300, 20} color={255, 0, 0, 255} /></Expanded>
+//     <Widget "Badge" />
+//   </Column>
+//
+// Values are numbers (Inf is infinity), tuples such as 500x50 or
+// {150..Inf, 0..Inf}, hex colors, names, calls such as tight_h(40) and quoted
+// strings, optionally keyed (name=value). A top-level <Widget "Name"> defines
+// a subtree that <Widget "Name" /> repeats; the other top-level element is
+// the root.
+//
+// Parsing produces a MarkupDocument: nodes in pre-order with their values,
+// viewing names and strings in the text. compile_markup writes the same
+// arrays as a binary image, which read_compiled_markup views in place (e.g.
+// in a mapped file), so instantiating a compiled screen is a single pass over
+// its nodes with no text to parse.
+
+struct MarkupValue {
+    enum Kind : u32 { Number, Tuple, Hex, Name, Call, String };
+    static constexpr u32 NO_KEY = ~0u;
+    Kind kind;
+    // symbol of the key, or NO_KEY
+    u32 key;
+    // Name, Call: symbol; Hex: RGBA color; String: offset in the strings
+    u32 u;
+    // Tuple, Call: numbers used; String: length
+    u32 count;
+    f32 n[4];
+};
+
+struct MarkupNode {
+    u32 type; // symbol of the element name
+    u32 first_value;
+    u32 value_count;
+    u32 child_count;
+    u32 subtree_size; // this node and its descendants, which follow it
+};
+
+// Parsed or loaded markup. The spans view either the storage vectors or the
+// compiled image; symbols and strings view the text or the image, which must
+// outlive the document.
+struct MarkupDocument {
+    std::span<MarkupNode const> nodes;
+    std::span<MarkupValue const> values;
+    std::vector<std::string_view> symbols;
+    std::string_view strings;
+    u32 root = 0;
+    std::vector<MarkupNode> node_storage;
+    std::vector<MarkupValue> value_storage;
+    MarkupDocument() = default;
+    MarkupDocument(MarkupDocument const&) = delete;
+    MarkupDocument& operator=(MarkupDocument const&) = delete;
+};
+
+class WidgetRegistry;
+
+// What a factory gets for one element: its values and its children, already
+// built.
+class MarkupArgs {
+    MarkupDocument const& doc;
+    std::vector<u32> const& remap;
+    std::string* error;
+    friend class MarkupBuilder;
+    MarkupArgs(MarkupDocument const& doc, std::vector<u32> const& remap, std::string* error) : doc(doc), remap(remap), error(error) {}
+public:
+    std::span<MarkupValue const> values;
+    // The factory moves out the children it keeps; the rest are destroyed.
+    std::span<std::unique_ptr<Widget>> children;
+    // i-th value without a key, or nullptr.
+    MarkupValue const* at(usize i) const;
+    // Value with the given key (a registry symbol), or nullptr.
+    MarkupValue const* get(u32 key) const;
+    // Registry symbol of a Name or Call value, or WidgetRegistry::NONE.
+    u32 symbol(MarkupValue const& v) const;
+    std::string_view string(MarkupValue const& v) const;
+    // Records the error for the element; returns nullptr for the factory to
+    // return.
+    Widget* fail(std::string_view message) const;
+};
+
+// Widget types by element name, and the names factories look for.
+class WidgetRegistry {
+public:
+    static constexpr u32 NONE = ~0u;
+    // Returns the widget, or args.fail(...).
+    using Factory = std::function<Widget*(MarkupArgs const& args)>;
+    // Interns a name, such as a key or a name used as a value.
+    u32 symbol(std::string_view name);
+    u32 find(std::string_view name) const;
+    void add(std::string_view type, Factory f);
+    Factory const* factory(u32 symbol) const { return symbol < factories.size() && factories[symbol] ? &factories[symbol] : nullptr; }
+    std::string_view name(u32 symbol) const { return names[symbol]; }
+    // The widgets of this library; copy it to add more.
+    static WidgetRegistry const& builtin();
+private:
+    std::vector<std::string> names;
+    std::unordered_map<std::string, u32> ids;
+    std::vector<Factory> factories;
+};
+
+// Parses markup text; the document views into it. Errors name the line.
+bool parse_markup(std::string_view text, MarkupDocument& doc, std::string* error = nullptr);
+// Writes the root subtree of a document as a compiled image.
+std::vector<u8> compile_markup(MarkupDocument const& doc);
+// Views a compiled image, which must be 4-byte aligned, without copying it.
+bool read_compiled_markup(std::span<u8 const> image, MarkupDocument& doc, std::string* error = nullptr);
+bool is_compiled_markup(std::span<u8 const> data);
+// Creates the widgets of a document's root subtree.
+std::unique_ptr<Widget> build_markup(MarkupDocument const& doc, WidgetRegistry const& reg = WidgetRegistry::builtin(), std::string* error = nullptr);
+// Maps a markup or compiled screen file into memory and builds it.
+std::unique_ptr<Widget> load_screen(const char* path, WidgetRegistry const& reg = WidgetRegistry::builtin(), std::string* error = nullptr);
+
+#endif // MARKUP_H_
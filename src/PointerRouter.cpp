@@ -0,0 +1,218 @@
+#include "PointerRouter.hpp"
+#include "RenderContext.hpp"
+#include "Widget.hpp"
+#include <algorithm>
+#include <cmath>
+
+PointerRouter::~PointerRouter() {
+    for (auto& e : entries) {
+        if (e.w) e.w->router = nullptr;
+    }
+}
+
+void PointerRouter::set_viewport(Size s) {
+    viewport = Rect::from_size(s);
+    cols = std::max(1, i32(std::ceil(s.w / CELL)));
+    rows = std::max(1, i32(std::ceil(s.h / CELL)));
+    cells.assign(usize(cols) * rows, Cell{});
+    large = Cell{};
+    // relinked by the next update
+    for (auto& e : entries) e.box = {};
+}
+
+void PointerRouter::update(Widget* w) {
+    PROFILE_ZONE("hit index");
+    RenderContext ctx;
+    ctx.clip = viewport;
+    chain.clear();
+    for (Widget* p = w->parent; p; p = p->parent) chain.push_back(p);
+    for (usize i = chain.size(); i-- > 0;) chain[i]->child_context(ctx);
+    visit(w, ctx);
+}
+
+void PointerRouter::visit(Widget* w, RenderContext const& ctx) {
+    if (w->pointer_target) place(w, ctx);
+    usize n = w->child_count();
+    if (n == 0) return;
+    RenderContext child_ctx = ctx;
+    w->child_context(child_ctx);
+    for (usize i = 0; i < n; i++) {
+        if (auto c = w->child_at(i)) visit(c, child_ctx);
+    }
+}
+
+void PointerRouter::place(Widget* w, RenderContext const& ctx) {
+    if (w->router != this) {
+        u32 slot;
+        if (free_slots.empty()) {
+            slot = entries.size();
+            entries.emplace_back();
+        } else {
+            slot = free_slots.back();
+            free_slots.pop_back();
+        }
+        entries[slot].w = w;
+        w->router = this;
+        w->hit_slot = slot;
+    }
+    Entry& e = entries[w->hit_slot];
+    e.origin = ctx.pos + w->render_pos;
+    e.z = ctx.z;
+    Rect box = Rect::from_pos_size(e.origin, w->render_size).intersected(ctx.clip);
+    if (box.empty()) box = {};
+    if (box == e.box) return;
+    e.box = box;
+    e.gen++;
+    link(w->hit_slot);
+}
+
+void PointerRouter::link(u32 slot) {
+    Rect const& b = entries[slot].box;
+    if (b.empty()) return;
+    i32 cx0 = std::clamp(i32(std::floor(b.x0 / CELL)), 0, cols);
+    i32 cy0 = std::clamp(i32(std::floor(b.y0 / CELL)), 0, rows);
+    i32 cx1 = std::clamp(i32(std::ceil(b.x1 / CELL)), 0, cols);
+    i32 cy1 = std::clamp(i32(std::ceil(b.y1 / CELL)), 0, rows);
+    if ((cx1 - cx0) * (cy1 - cy0) > LARGE_CELLS) {
+        add_ref(large, slot);
+        return;
+    }
+    for (i32 y = cy0; y < cy1; y++) {
+        for (i32 x = cx0; x < cx1; x++) add_ref(cells[usize(y) * cols + x], slot);
+    }
+}
+
+void PointerRouter::add_ref(Cell& c, u32 slot) {
+    c.refs.push_back({ slot, entries[slot].gen });
+    if (c.refs.size() < c.compact_at) return;
+    std::erase_if(c.refs, [&](Ref r) { return entries[r.slot].gen != r.gen; });
+    c.compact_at = std::max<usize>(16, c.refs.size() * 2);
+}
+
+void PointerRouter::remove(Widget* w) {
+    std::lock_guard lock(remove_mutex);
+    if (w->router != this) return;
+    Entry& e = entries[w->hit_slot];
+    e.w = nullptr;
+    e.box = {};
+    e.gen++;
+    free_slots.push_back(w->hit_slot);
+    w->router = nullptr;
+    if (hovered == w) hovered = nullptr;
+    if (captured == w) captured = nullptr;
+}
+
+bool PointerRouter::above(Entry const& a, Entry const& b) const {
+    if (a.z != b.z) return a.z > b.z;
+    usize da = 0, db = 0;
+    for (Widget* p = a.w; p; p = p->parent) da++;
+    for (Widget* p = b.w; p; p = p->parent) db++;
+    Widget* x = a.w;
+    Widget* y = b.w;
+    for (usize d = da; d > db; d--) x = x->parent;
+    for (usize d = db; d > da; d--) y = y->parent;
+    // one contains the other: the deeper one gets the event first
+    if (x == y) return da > db;
+    while (x->parent != y->parent) {
+        x = x->parent;
+        y = y->parent;
+    }
+    Widget* common = x->parent;
+    if (!common) return false;
+    for (usize i = 0; i < common->child_count(); i++) {
+        Widget* c = common->child_at(i);
+        if (c == x) return true;
+        if (c == y) return false;
+    }
+    return false;
+}
+
+Widget* PointerRouter::hit_test(Position p) const {
+    if (cells.empty() || !viewport.contains(p)) return nullptr;
+    i32 cx = std::min(i32(p.x / CELL), cols - 1);
+    i32 cy = std::min(i32(p.y / CELL), rows - 1);
+    Entry const* best = nullptr;
+    auto scan = [&](Cell const& c) {
+        for (Ref r : c.refs) {
+            Entry const& e = entries[r.slot];
+            if (e.gen != r.gen || !e.box.contains(p)) continue;
+            if (!best || above(e, *best)) best = &e;
+        }
+    };
+    scan(cells[usize(cy) * cols + cx]);
+    scan(large);
+    return best ? best->w : nullptr;
+}
+
+bool PointerRouter::send(Widget* w, PointerEvent e) {
+    e.local = e.pos - entries[w->hit_slot].origin;
+    return w->on_pointer(e);
+}
+
+Widget* PointerRouter::bubble(Widget* w, PointerEvent const& e) {
+    for (; w; w = w->parent) {
+        if (w->router == this && send(w, e)) return w;
+    }
+    return nullptr;
+}
+
+void PointerRouter::hover(Widget* w) {
+    if (w == hovered) return;
+    Widget* old = hovered;
+    hovered = w;
+    PointerEvent e;
+    e.pos = last_pos;
+    if (old) {
+        e.type = PointerEvent::Leave;
+        send(old, e);
+    }
+    // the Leave handler may have removed w
+    if (w && w == hovered) {
+        e.type = PointerEvent::Enter;
+        send(w, e);
+    }
+}
+
+bool PointerRouter::dispatch(PointerEvent e) {
+    switch (e.type) {
+    case PointerEvent::Move:
+        last_pos = e.pos;
+        inside = true;
+        hover(hit_test(e.pos));
+        if (captured) return send(captured, e);
+        return hovered && send(hovered, e);
+    case PointerEvent::Press: {
+        last_pos = e.pos;
+        inside = true;
+        hover(hit_test(e.pos));
+        Widget* w = bubble(hovered, e);
+        if (w && !captured) {
+            captured = w;
+            capture_button = e.button;
+        }
+        return w;
+    }
+    case PointerEvent::Release:
+        if (captured && e.button == capture_button) {
+            Widget* w = captured;
+            captured = nullptr;
+            return send(w, e);
+        }
+        return bubble(hit_test(e.pos), e);
+    case PointerEvent::Wheel:
+        return bubble(hit_test(e.pos), e);
+    case PointerEvent::Enter:
+    case PointerEvent::Leave:
+        break;
+    }
+    return false;
+}
+
+void PointerRouter::leave() {
+    inside = false;
+    hover(nullptr);
+}
+
+void PointerRouter::refresh_hover() {
+    if (inside) hover(hit_test(last_pos));
+}
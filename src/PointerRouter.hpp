@@ -0,0 +1,114 @@
+#ifndef POINTERROUTER_H_
+#define POINTERROUTER_H_
+
+#include "types.hpp"
+#include <mutex>
+#include <vector>
+
+class Widget;
+struct RenderContext;
+
+struct PointerEvent {
+    enum Type : u8 {
+        Move,
+        Press,
+        Release,
+        Wheel,
+        // the pointer started or stopped being over the widget
+        Enter,
+        Leave,
+    };
+    enum Button : u8 {
+        NoButton,
+        Left,
+        Middle,
+        Right,
+    };
+    Type type = Move;
+    Button button = NoButton;
+    // window space, and relative to the receiving widget's box
+    Position pos;
+    Position local;
+    // pixels to scroll the content by, for Wheel
+    Position scroll;
+};
+
+// Routes pointer events to the widgets that called set_pointer_target. Their
+// window-space boxes, clipped like their painting, are kept in a uniform grid
+// over the window, so finding the widget under the pointer only looks at the
+// targets sharing its cell. After layout, update() re-indexes the subtrees
+// that were laid out again.
+//
+// The target under the pointer is the one with the highest depth; at equal
+// depth, descendants come before their ancestors, and otherwise the one
+// painted first, as the depth test keeps the first fragment. Press, Release
+// and Wheel bubble up through the ancestor targets until one returns true
+// from on_pointer. Whoever takes a Press captures the pointer: it gets every
+// Move and the Release until the button goes up.
+class PointerRouter {
+public:
+    ~PointerRouter();
+    // Call on resize, followed by update() of the root.
+    void set_viewport(Size s);
+    // Re-indexes the targets below w, w included. w must have been laid out.
+    void update(Widget* w);
+    // Drops w from the index. Thread-safe, as widgets can be destroyed during
+    // parallel layout.
+    void remove(Widget* w);
+    Widget* hit_test(Position p) const;
+    // Returns whether a widget handled the event. Enter and Leave are
+    // generated from Move events.
+    bool dispatch(PointerEvent e);
+    // The pointer left the window.
+    void leave();
+    // Sends Enter and Leave after the widgets under a still pointer moved.
+    void refresh_hover();
+    Widget* get_hovered() const { return hovered; }
+    Widget* get_captured() const { return captured; }
+    usize target_count() const { return entries.size() - free_slots.size(); }
+private:
+    static constexpr f32 CELL = 32.f;
+    // targets covering more cells are kept in one list instead
+    static constexpr i32 LARGE_CELLS = 64;
+    struct Entry {
+        Widget* w = nullptr;
+        Position origin;
+        Rect box; // clipped, empty if nothing of it can be seen
+        f32 z = 0.f;
+        // bumped whenever the entry moves or goes, which makes the references
+        // to it in the cells stale
+        u32 gen = 0;
+    };
+    struct Ref { u32 slot, gen; };
+    // Stale references are only dropped once the cell has doubled in size
+    // since the last time, so moving a target costs no search.
+    struct Cell {
+        std::vector<Ref> refs;
+        usize compact_at = 16;
+    };
+    i32 cols = 0;
+    i32 rows = 0;
+    Rect viewport;
+    std::vector<Cell> cells;
+    Cell large;
+    std::vector<Entry> entries;
+    std::vector<u32> free_slots;
+    std::vector<Widget*> chain; // scratch for update
+    std::mutex remove_mutex;
+    Widget* hovered = nullptr;
+    Widget* captured = nullptr;
+    PointerEvent::Button capture_button = PointerEvent::NoButton;
+    Position last_pos;
+    bool inside = false;
+    void visit(Widget* w, RenderContext const& ctx);
+    void place(Widget* w, RenderContext const& ctx);
+    void link(u32 slot);
+    void add_ref(Cell& c, u32 slot);
+    bool above(Entry const& a, Entry const& b) const;
+    void hover(Widget* w);
+    bool send(Widget* w, PointerEvent e);
+    // Returns the target that handled e, if any.
+    Widget* bubble(Widget* w, PointerEvent const& e);
+};
+
+#endif // POINTERROUTER_H_
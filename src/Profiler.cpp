@@ -0,0 +1,93 @@
+#include "Profiler.hpp"
+
+#ifdef UILIB_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct ZoneEvent {
+    const char* name;
+    bool type_name;
+    u64 begin;
+    u64 end;
+};
+
+// Written only by its thread; head is published with release so an exporter
+// sees complete events.
+struct ThreadRing {
+    u32 tid;
+    std::atomic<u64> head{0};
+    ZoneEvent events[Profiler::RING_SIZE];
+};
+
+// Rings outlive their threads so their zones can still be exported.
+static std::mutex rings_mutex;
+static std::vector<ThreadRing*> rings;
+static thread_local ThreadRing* ring = nullptr;
+
+static ThreadRing* register_thread() {
+    ThreadRing* r = new ThreadRing;
+    std::lock_guard lock(rings_mutex);
+    r->tid = rings.size() + 1;
+    rings.push_back(r);
+    return r;
+}
+
+u64 Profiler::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::record(const char* name, bool type_name, u64 begin_ns, u64 end_ns) {
+    if (!ring) ring = register_thread();
+    u64 h = ring->head.load(std::memory_order_relaxed);
+    ring->events[h % RING_SIZE] = { name, type_name, begin_ns, end_ns };
+    ring->head.store(h + 1, std::memory_order_release);
+}
+
+static std::string json_name(ZoneEvent const& e) {
+    std::string name = e.name;
+    if (e.type_name) {
+        int status = 0;
+        char* d = abi::__cxa_demangle(e.name, nullptr, nullptr, &status);
+        if (status == 0 && d) name = d;
+        free(d);
+    }
+    std::string out;
+    for (char c : name) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+bool Profiler::write_chrome_trace(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    std::lock_guard lock(rings_mutex);
+    u64 origin = ~0ull;
+    for (auto r : rings) {
+        u64 h = r->head.load(std::memory_order_acquire);
+        for (u64 i = h > RING_SIZE ? h - RING_SIZE : 0; i < h; i++) origin = std::min(origin, r->events[i % RING_SIZE].begin);
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    for (auto r : rings) {
+        u64 h = r->head.load(std::memory_order_acquire);
+        for (u64 i = h > RING_SIZE ? h - RING_SIZE : 0; i < h; i++) {
+            ZoneEvent const& e = r->events[i % RING_SIZE];
+            fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",", json_name(e).c_str(), r->tid, (e.begin - origin) / 1000.0, (e.end - e.begin) / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+#endif // UILIB_PROFILE
@@ -0,0 +1,50 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#include "defines.h"
+
+// Scoped timing zones, recorded only when built with UILIB_PROFILE; otherwise
+// the macros expand to nothing.
+//
+//   PROFILE_ZONE("layout");        // until the end of the enclosing scope
+//   PROFILE_WIDGET_ZONE(*this);    // named after the dynamic widget type
+//
+// Each thread appends to its own ring buffer holding the last RING_SIZE zones,
+// so recording takes no lock. write_chrome_trace dumps them as Chrome trace
+// JSON (chrome://tracing, ui.perfetto.dev); zones nest by time.
+#ifdef UILIB_PROFILE
+
+#include <typeinfo>
+
+namespace Profiler {
+    constexpr usize RING_SIZE = 1 << 16;
+    u64 now_ns();
+    // type_name: name is a mangled type name, demangled on export.
+    void record(const char* name, bool type_name, u64 begin_ns, u64 end_ns);
+    // Meant to be called while no other thread is recording.
+    bool write_chrome_trace(const char* path);
+}
+
+class ProfileZone {
+    const char* name;
+    bool type_name;
+    u64 begin;
+public:
+    ProfileZone(const char* name) : name(name), type_name(false), begin(Profiler::now_ns()) {}
+    ProfileZone(std::type_info const& t) : name(t.name()), type_name(true), begin(Profiler::now_ns()) {}
+    ~ProfileZone() { Profiler::record(name, type_name, begin, Profiler::now_ns()); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __COUNTER__)(name)
+#define PROFILE_WIDGET_ZONE(w) ProfileZone PROFILE_CONCAT(profile_zone_, __COUNTER__)(typeid(w))
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_WIDGET_ZONE(w) ((void)0)
+
+#endif // UILIB_PROFILE
+
+#endif // PROFILER_H_
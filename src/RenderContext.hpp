@@ -2,17 +2,48 @@
 #define RENDERCONTEXT_INCLUDED_H
 
 #include "DrawBatch.hpp"
+#include "Font.hpp"
 #include "types.hpp"
 //#include <iostream>
 
 struct RenderContext {
     Position pos = {0, 0};
     f32 z = 0.f;
-    DrawBatch* b;
+    // Without a batch, painting only traverses the tree.
+    DrawBatch* b = nullptr;
+    // Window-space area that can be seen: everything drawn is clipped to it,
+    // and subtrees entirely outside of it are skipped by Widget::paint. Clips
+    // nest as a stack: clip_to narrows it, and the push_rctx_pos of the
+    // widget that called it restores it.
+    Rect clip = Rect::everything();
+    // Where text is rasterized; without one, text is not drawn.
+    GlyphAtlas* glyphs = nullptr;
+    void clip_to(Rect r) { clip = clip.intersected(r); }
     void draw_rectangle(f32 x, f32 y, f32 w, f32 h, Color c, f32 z = 0.0) {
         (void) x, (void) y, (void) z, (void) w, (void) h, (void) c;
         // std::cout << "DRAW_RECT: " << x << "," << y << " - " << w << "x" << h << " z=" << z << "\n";
-        b->draw_rectangle((i32)x, (i32)(x + w), (i32)y, (i32)(y + h), z, c);
+        if (b) b->draw_rectangle(x, x + w, y, y + h, z, c, clip);
+    }
+    void draw_rounded_rectangle(f32 x, f32 y, f32 w, f32 h, f32 radius, Color c, f32 z = 0.0) {
+        if (b) b->draw_rounded_rectangle(x, x + w, y, y + h, z, c, radius, 0.f, clip);
+    }
+    // A border of the given width inside the rectangle; 0 fills it.
+    void draw_border(f32 x, f32 y, f32 w, f32 h, f32 radius, f32 width, Color c, f32 z = 0.0) {
+        if (b) b->draw_rounded_rectangle(x, x + w, y, y + h, z, c, radius, width, clip);
+    }
+    void draw_circle(f32 cx, f32 cy, f32 r, Color c, f32 z = 0.0) {
+        if (b) b->draw_rounded_rectangle(cx - r, cx + r, cy - r, cy + r, z, c, r, 0.f, clip);
+    }
+    // Covers `blur` more pixels than the rectangle on every side.
+    void draw_shadow(f32 x, f32 y, f32 w, f32 h, f32 radius, f32 blur, Color c, f32 z = 0.0) {
+        if (b) b->draw_shadow(x, x + w, y, y + h, z, c, radius, blur, clip);
+    }
+    // In window coordinates: ctx.pos is not added.
+    void draw_rectangles(std::span<DrawBatch::RectCmd const> rects) {
+        if (b) b->draw_rectangles(rects, clip);
+    }
+    void draw_text(TextRun const& run, f32 x, f32 y, Color c, f32 z = 0.0) {
+        if (b && glyphs) glyphs->draw(*b, run, Position(x, y), z, c, clip);
     }
 };
 
@@ -20,9 +51,10 @@ class PushRenderContextPosRAII {
     RenderContext* ctx_ptr;
     Position pos;
     float z;
+    Rect clip;
 public:
-    PushRenderContextPosRAII(RenderContext& ctx) { pos = ctx.pos; z = ctx.z; ctx_ptr = &ctx; }
-    ~PushRenderContextPosRAII() { ctx_ptr->pos = pos; ctx_ptr->z = z; }
+    PushRenderContextPosRAII(RenderContext& ctx) { pos = ctx.pos; z = ctx.z; clip = ctx.clip; ctx_ptr = &ctx; }
+    ~PushRenderContextPosRAII() { ctx_ptr->pos = pos; ctx_ptr->z = z; ctx_ptr->clip = clip; }
 };
 
 #define push_rctx_pos(ctx) auto __push_render_context_pos_var__ = PushRenderContextPosRAII(ctx)
@@ -0,0 +1,87 @@
+#include "RenderThread.hpp"
+#include "Profiler.hpp"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_video.h>
+#include <utility>
+
+RenderThread::RenderThread(void* window, void* context, DrawBatch* gpu, FrameScheduler* scheduler)
+    : window(window), context(context), gpu(gpu), scheduler(scheduler) {
+    // a context is current on one thread at a time
+    SDL_GL_MakeCurrent(static_cast<SDL_Window*>(window), nullptr);
+    thread = std::thread([this] { main(); });
+}
+
+RenderThread::~RenderThread() {
+    stop.store(true, std::memory_order_release);
+    wake();
+    thread.join();
+    SDL_GL_MakeCurrent(static_cast<SDL_Window*>(window), static_cast<SDL_GLContext>(context));
+}
+
+void RenderThread::wake() {
+    signal.fetch_add(1, std::memory_order_release);
+    signal.notify_one();
+}
+
+void RenderThread::present(FramePacket& p) {
+    u32 h = head.load(std::memory_order_relaxed);
+    for (u32 t = tail.load(std::memory_order_acquire); h - t == SLOTS; t = tail.load(std::memory_order_acquire)) {
+        PROFILE_ZONE("wait for render thread");
+        tail.wait(t, std::memory_order_acquire);
+    }
+    // the slot's previous packet has been drawn: its buffers go back to p
+    std::swap(slots[h % SLOTS], p);
+    head.store(h + 1, std::memory_order_release);
+    wake();
+}
+
+void RenderThread::call(std::function<void()> const& f) {
+    u32 h = head.load(std::memory_order_relaxed);
+    for (u32 t = tail.load(std::memory_order_acquire); t != h; t = tail.load(std::memory_order_acquire)) tail.wait(t, std::memory_order_acquire);
+    u32 target;
+    {
+        std::lock_guard lock(calls_mutex);
+        calls.push_back(&f);
+        target = calls_done.load(std::memory_order_relaxed) + calls.size();
+    }
+    wake();
+    for (u32 d = calls_done.load(std::memory_order_acquire); d < target; d = calls_done.load(std::memory_order_acquire)) calls_done.wait(d, std::memory_order_acquire);
+}
+
+void RenderThread::main() {
+    SDL_Window* w = static_cast<SDL_Window*>(window);
+    SDL_GL_MakeCurrent(w, static_cast<SDL_GLContext>(context));
+    std::vector<std::function<void()> const*> running;
+    while (true) {
+        u32 seen = signal.load(std::memory_order_acquire);
+        {
+            std::lock_guard lock(calls_mutex);
+            running.swap(calls);
+        }
+        if (!running.empty()) {
+            for (auto f : running) (*f)();
+            calls_done.fetch_add(running.size(), std::memory_order_release);
+            calls_done.notify_all();
+            running.clear();
+        }
+        u32 t = tail.load(std::memory_order_relaxed);
+        if (t != head.load(std::memory_order_acquire)) {
+            PROFILE_ZONE("render frame");
+            i64 start = FrameScheduler::now_ns();
+            gpu->execute(slots[t % SLOTS]);
+            i64 executed = FrameScheduler::now_ns();
+            {
+                PROFILE_ZONE("swap");
+                SDL_GL_SwapWindow(w);
+            }
+            if (scheduler) scheduler->frame_presented(FrameScheduler::now_ns(), executed - start);
+            tail.store(t + 1, std::memory_order_release);
+            tail.notify_one();
+            continue;
+        }
+        // only once everything handed over is on screen
+        if (stop.load(std::memory_order_acquire)) break;
+        signal.wait(seen, std::memory_order_acquire);
+    }
+    SDL_GL_MakeCurrent(w, nullptr);
+}
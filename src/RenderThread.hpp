@@ -0,0 +1,58 @@
+#ifndef RENDERTHREAD_H_
+#define RENDERTHREAD_H_
+
+#include "DrawBatch.hpp"
+#include "FrameScheduler.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Owns the GL context on a thread of its own, which executes the frame
+// packets of a Deferred DrawBatch with an OpenGL one and swaps the window.
+// Frames are handed over through two packet slots, claimed with atomic
+// indices and waited on with atomic waits, so the thread building frames
+// only blocks when it is two frames ahead: one frame is being recorded, one
+// waits and one is drawn or waits for vsync.
+class RenderThread {
+public:
+    // window and context are an SDL_Window* and its SDL_GLContext, current
+    // on the calling thread until then; gpu is an OpenGL batch created in it.
+    // Every swap is reported to scheduler, if there is one.
+    RenderThread(void* window, void* context, DrawBatch* gpu, FrameScheduler* scheduler = nullptr);
+    // Presents the frames handed over, then makes the context current on the
+    // calling thread again.
+    ~RenderThread();
+    RenderThread(RenderThread const&) = delete;
+    RenderThread& operator=(RenderThread const&) = delete;
+    // Queues p for presenting and gives back the buffers of an older packet.
+    void present(FramePacket& p);
+    // Runs f with the context current, after the frames handed over so far,
+    // and waits for it.
+    void call(std::function<void()> const& f);
+    // Frames handed over and not presented yet.
+    u32 in_flight() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+private:
+    static constexpr u32 SLOTS = 2;
+    void* window;
+    void* context;
+    DrawBatch* gpu;
+    FrameScheduler* scheduler;
+    FramePacket slots[SLOTS];
+    // packets [tail, head) are queued; the producer writes head, the render
+    // thread tail
+    std::atomic<u32> head{0};
+    std::atomic<u32> tail{0};
+    // bumped for every new packet, call and the stop request
+    std::atomic<u32> signal{0};
+    std::atomic<bool> stop{false};
+    std::mutex calls_mutex;
+    std::vector<std::function<void()> const*> calls;
+    std::atomic<u32> calls_done{0};
+    std::thread thread;
+    void main();
+    void wake();
+};
+
+#endif // RENDERTHREAD_H_
@@ -0,0 +1,280 @@
+#include "SoftwareRasterizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Same mapping as the projection matrix in DrawBatch: ndc z = -0.001 z, and
+// the depth range maps [-1, 1] to [0, 1].
+static f32 window_depth(f32 z) { return 0.5f - 0.0005f * z; }
+
+static u32 pack(Color c) {
+    u32 p;
+    std::memcpy(&p, &c, sizeof(p));
+    return p;
+}
+
+// x / 255 rounded down, exact for the range blending produces.
+static u32 div255(u32 x) { return (x + 1 + (x >> 8)) >> 8; }
+
+static u32 blend(u32 src, u32 dst, u32 a) {
+    u32 out = 0;
+    for (u32 shift = 0; shift < 32; shift += 8) {
+        u32 s = (src >> shift) & 0xff;
+        u32 d = (dst >> shift) & 0xff;
+        out |= div255(s * a + d * (255 - a) + 127) << shift;
+    }
+    return out;
+}
+
+static void fill_span(u32* col, f32* dep, u32 n, u32 src, u32 a, f32 d) {
+    u32 i = 0;
+#ifdef __SSE2__
+    const __m128 dv = _mm_set1_ps(d);
+    const __m128i sv = _mm_set1_epi32(src);
+    if (a == 255) {
+        for (; i + 4 <= n; i += 4) {
+            __m128 old_d = _mm_loadu_ps(dep + i);
+            __m128 pass = _mm_cmplt_ps(dv, old_d);
+            __m128i mask = _mm_castps_si128(pass);
+            __m128i old_c = _mm_loadu_si128(reinterpret_cast<__m128i*>(col + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(col + i), _mm_or_si128(_mm_and_si128(mask, sv), _mm_andnot_si128(mask, old_c)));
+            _mm_storeu_ps(dep + i, _mm_or_ps(_mm_and_ps(pass, dv), _mm_andnot_ps(pass, old_d)));
+        }
+    } else {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i s16 = _mm_unpacklo_epi8(sv, zero);
+        const __m128i sa = _mm_mullo_epi16(s16, _mm_set1_epi16(a));
+        const __m128i ia = _mm_set1_epi16(255 - a);
+        const __m128i bias = _mm_set1_epi16(127);
+        const __m128i one = _mm_set1_epi16(1);
+        auto blend8 = [&](__m128i d16) {
+            __m128i x = _mm_add_epi16(_mm_add_epi16(sa, _mm_mullo_epi16(d16, ia)), bias);
+            return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(x, one), _mm_srli_epi16(x, 8)), 8);
+        };
+        for (; i + 4 <= n; i += 4) {
+            __m128 old_d = _mm_loadu_ps(dep + i);
+            __m128 pass = _mm_cmplt_ps(dv, old_d);
+            __m128i mask = _mm_castps_si128(pass);
+            __m128i old_c = _mm_loadu_si128(reinterpret_cast<__m128i*>(col + i));
+            __m128i lo = blend8(_mm_unpacklo_epi8(old_c, zero));
+            __m128i hi = blend8(_mm_unpackhi_epi8(old_c, zero));
+            __m128i new_c = _mm_packus_epi16(lo, hi);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(col + i), _mm_or_si128(_mm_and_si128(mask, new_c), _mm_andnot_si128(mask, old_c)));
+            _mm_storeu_ps(dep + i, _mm_or_ps(_mm_and_ps(pass, dv), _mm_andnot_ps(pass, old_d)));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (!(d < dep[i])) continue;
+        col[i] = a == 255 ? src : blend(src, col[i], a);
+        dep[i] = d;
+    }
+}
+
+// fill_span with a coverage per pixel, which also becomes the source alpha;
+// what the shader leaves transparent keeps its depth.
+static void fill_coverage(u32* col, f32* dep, u32 n, u32 src, u32 alpha, u8 const* cov, f32 d) {
+    for (u32 i = 0; i < n; i++) {
+        u32 a = div255(alpha * cov[i] + 127);
+        if (a == 0 || !(d < dep[i])) continue;
+        col[i] = blend((src & 0x00ffffffu) | a << 24, col[i], a);
+        dep[i] = d;
+    }
+}
+
+static f32 smoothstep(f32 e0, f32 e1, f32 x) {
+    f32 t = std::clamp((x - e0) / (e1 - e0), 0.f, 1.f);
+    return t * t * (3.f - 2.f * t);
+}
+
+// A shape instance unpacked as in the vertex shader, and the coverage its
+// fragment shader computes at an offset from the center of the quad.
+struct ShapeParams {
+    f32 cx, cy, hw, hh, radius, border, blur;
+    ShapeParams(rect_instance_t const& r) {
+        blur = f32(r.v >> 8);
+        cx = r.x + r.w * 0.5f, cy = r.y + r.h * 0.5f;
+        hw = std::max(std::abs(f32(r.w)) * 0.5f - blur, 0.f);
+        hh = std::max(std::abs(f32(r.h)) * 0.5f - blur, 0.f);
+        radius = std::min({ f32(r.u & 0x7fff) * 0.25f, hw, hh });
+        border = f32(r.v & 0xff) * 0.25f;
+    }
+    u8 coverage(f32 x, f32 y) const {
+        f32 qx = std::abs(x) - hw + radius, qy = std::abs(y) - hh + radius;
+        f32 ox = std::max(qx, 0.f), oy = std::max(qy, 0.f);
+        f32 d = std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.f) - radius;
+        if (border > 0.f) d = std::abs(d + border * 0.5f) - border * 0.5f;
+        f32 c = blur > 0.f ? 1.f - smoothstep(-blur, blur, d) : std::clamp(0.5f - d, 0.f, 1.f);
+        return u8(std::nearbyint(c * 255.f));
+    }
+};
+
+SoftwareRasterizer::SoftwareRasterizer(u32 threads) : next_tile(0) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // the calling thread rasterizes too
+    for (u32 i = 1; i < threads; i++) workers.emplace_back([this] { worker_main(); });
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() {
+    {
+        std::lock_guard lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+void SoftwareRasterizer::resize(u32 w, u32 h) {
+    this->w = w;
+    this->h = h;
+    tiles_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (h + TILE_SIZE - 1) / TILE_SIZE;
+    color.assign(usize(w) * h, 0);
+    depth.assign(usize(w) * h, 1.f);
+    bins.resize(tiles_x * tiles_y);
+}
+
+void SoftwareRasterizer::clear(Color c) {
+    if (scissor.empty()) {
+        std::fill(color.begin(), color.end(), pack(c));
+        std::fill(depth.begin(), depth.end(), 1.f);
+        return;
+    }
+    for (Box const& b : scissor) {
+        for (i32 y = b.y0; y < b.y1; y++) {
+            usize row = usize(y) * w;
+            std::fill(color.begin() + row + b.x0, color.begin() + row + b.x1, pack(c));
+            std::fill(depth.begin() + row + b.x0, depth.begin() + row + b.x1, 1.f);
+        }
+    }
+}
+
+void SoftwareRasterizer::set_scissor(std::span<Rect const> boxes) {
+    scissor.clear();
+    for (Rect const& r : boxes) {
+        Box b = { std::max<i32>(i32(r.x0), 0), std::max<i32>(i32(r.y0), 0), std::min<i32>(i32(r.x1), w), std::min<i32>(i32(r.y1), h) };
+        if (b.x0 < b.x1 && b.y0 < b.y1) scissor.push_back(b);
+    }
+    // boxes that all fell outside still limit drawing, to nothing
+    if (scissor.empty() && !boxes.empty()) scissor.push_back({ 0, 0, 0, 0 });
+}
+
+void SoftwareRasterizer::draw(rect_instance_t const* r, usize n) {
+    queue.insert(queue.end(), r, r + n);
+}
+
+void SoftwareRasterizer::flush() {
+    if (queue.empty() || tiles_x == 0 || tiles_y == 0) {
+        queue.clear();
+        return;
+    }
+    for (auto& b : bins) b.clear();
+    // only tiles under the scissor boxes get anything
+    Box limit = { 0, 0, i32(w), i32(h) };
+    if (!scissor.empty()) {
+        limit = scissor[0];
+        for (Box const& b : scissor) limit = { std::min(limit.x0, b.x0), std::min(limit.y0, b.y0), std::max(limit.x1, b.x1), std::max(limit.y1, b.y1) };
+    }
+    for (u32 i = 0; i < queue.size(); i++) {
+        rect_instance_t const& r = queue[i];
+        i32 x0 = std::max<i32>({ limit.x0, r.clip_x0, std::min<i32>(r.x, r.x + r.w) });
+        i32 x1 = std::min<i32>({ limit.x1, r.clip_x1, std::max<i32>(r.x, r.x + r.w) });
+        i32 y0 = std::max<i32>({ limit.y0, r.clip_y0, std::min<i32>(r.y, r.y + r.h) });
+        i32 y1 = std::min<i32>({ limit.y1, r.clip_y1, std::max<i32>(r.y, r.y + r.h) });
+        if (x0 >= x1 || y0 >= y1) continue;
+        f32 d = window_depth(r.z);
+        if (d < 0.f || d > 1.f) continue;
+        for (i32 ty = y0 / TILE_SIZE; ty <= (y1 - 1) / i32(TILE_SIZE); ty++) {
+            for (i32 tx = x0 / TILE_SIZE; tx <= (x1 - 1) / i32(TILE_SIZE); tx++) {
+                bins[ty * tiles_x + tx].push_back(i);
+            }
+        }
+    }
+    {
+        std::lock_guard lock(mutex);
+        next_tile = 0;
+        busy = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    run_tiles();
+    std::unique_lock lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+    queue.clear();
+}
+
+void SoftwareRasterizer::worker_main() {
+    u64 seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [&] { return quit || generation != seen; });
+            if (quit) return;
+            seen = generation;
+        }
+        run_tiles();
+        {
+            std::lock_guard lock(mutex);
+            busy--;
+        }
+        done.notify_one();
+    }
+}
+
+void SoftwareRasterizer::run_tiles() {
+    u32 count = tiles_x * tiles_y;
+    for (u32 t = next_tile++; t < count; t = next_tile++) raster_tile(t);
+}
+
+void SoftwareRasterizer::raster_tile(u32 tile) {
+    i32 tx0 = (tile % tiles_x) * TILE_SIZE;
+    i32 ty0 = (tile / tiles_x) * TILE_SIZE;
+    Box t = { tx0, ty0, std::min<i32>(tx0 + TILE_SIZE, w), std::min<i32>(ty0 + TILE_SIZE, h) };
+    if (bins[tile].empty()) return;
+    if (scissor.empty()) return raster_box(bins[tile], t);
+    for (Box const& b : scissor) {
+        Box part = { std::max(t.x0, b.x0), std::max(t.y0, b.y0), std::min(t.x1, b.x1), std::min(t.y1, b.y1) };
+        if (part.x0 < part.x1 && part.y0 < part.y1) raster_box(bins[tile], part);
+    }
+}
+
+// Draws the instances of a bin within box, which lies in their tile.
+void SoftwareRasterizer::raster_box(std::vector<u32> const& bin, Box const& box) {
+    for (u32 i : bin) {
+        rect_instance_t const& r = queue[i];
+        i32 x0 = std::max<i32>({ box.x0, r.clip_x0, std::min<i32>(r.x, r.x + r.w) });
+        i32 x1 = std::min<i32>({ box.x1, r.clip_x1, std::max<i32>(r.x, r.x + r.w) });
+        i32 y0 = std::max<i32>({ box.y0, r.clip_y0, std::min<i32>(r.y, r.y + r.h) });
+        i32 y1 = std::min<i32>({ box.y1, r.clip_y1, std::max<i32>(r.y, r.y + r.h) });
+        if (x0 >= x1 || y0 >= y1) continue;
+        f32 d = window_depth(r.z);
+        u32 src = pack(r.c);
+        if (r.u & rect_instance_t::SHAPE) {
+            ShapeParams shape(r);
+            u8 cov[TILE_SIZE];
+            for (i32 y = y0; y < y1; y++) {
+                usize row = usize(y) * w;
+                for (i32 x = x0; x < x1; x++) cov[x - x0] = shape.coverage(x + 0.5f - shape.cx, y + 0.5f - shape.cy);
+                fill_coverage(color.data() + row + x0, depth.data() + row + x0, x1 - x0, src, r.c.a, cov, d);
+            }
+            continue;
+        }
+        if (r.u | r.v) {
+            // texels outside of the atlas read as zero coverage
+            if (r.w < 0 || r.h < 0 || u32(r.u) + r.w > atlas_w || u32(r.v) + r.h > atlas_h) continue;
+            for (i32 y = y0; y < y1; y++) {
+                usize row = usize(y) * w;
+                u8 const* cov = atlas + usize(r.v + y - r.y) * atlas_w + r.u + (x0 - r.x);
+                fill_coverage(color.data() + row + x0, depth.data() + row + x0, x1 - x0, src, r.c.a, cov, d);
+            }
+            continue;
+        }
+        for (i32 y = y0; y < y1; y++) {
+            usize row = usize(y) * w;
+            fill_span(color.data() + row + x0, depth.data() + row + x0, x1 - x0, src, r.c.a, d);
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef SOFTWARERASTERIZER_H_
+#define SOFTWARERASTERIZER_H_
+
+#include "DrawBatch.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+// CPU version of what the OpenGL DrawBatch does with rectangle instances:
+// GL_LESS depth test with the same z mapping, then SRC_ALPHA /
+// ONE_MINUS_SRC_ALPHA blending into an RGBA8 framebuffer. Rectangles are
+// binned per tile in submission order and tiles are rasterized in parallel,
+// so the output does not depend on the number of threads. Textured instances
+// scale their alpha by the atlas coverage, rounded like the shader does, and
+// shapes by the coverage the shader computes from their distance. Nothing is
+// drawn outside of the clip box of an instance, nor outside of the scissor
+// boxes when there are any.
+class SoftwareRasterizer {
+public:
+    static constexpr u32 TILE_SIZE = 64;
+    // threads = 0 uses one thread per hardware thread.
+    SoftwareRasterizer(u32 threads = 0);
+    ~SoftwareRasterizer();
+    void resize(u32 w, u32 h);
+    void clear(Color c);
+    // Limits clear() and flush() to these boxes, in whole pixels, which must
+    // not overlap. With none, the whole framebuffer is drawn.
+    void set_scissor(std::span<Rect const> boxes);
+    // Queues rectangles; they are rasterized in queue order by flush().
+    void draw(rect_instance_t const* r, usize n);
+    void flush();
+    // One byte per texel; read by flush(), so it must stay valid until then.
+    void set_atlas(u8 const* pixels, u32 w, u32 h) { atlas = pixels, atlas_w = w, atlas_h = h; }
+    u32 width() const { return w; }
+    u32 height() const { return h; }
+    // RGBA8, top row first.
+    u8 const* pixels() const { return reinterpret_cast<u8 const*>(color.data()); }
+private:
+    u32 w = 0;
+    u32 h = 0;
+    u32 tiles_x = 0;
+    u32 tiles_y = 0;
+    std::vector<u32> color;
+    std::vector<f32> depth;
+    std::vector<rect_instance_t> queue;
+    u8 const* atlas = nullptr;
+    u32 atlas_w = 0;
+    u32 atlas_h = 0;
+    std::vector<std::vector<u32>> bins;
+    struct Box { i32 x0, y0, x1, y1; };
+    std::vector<Box> scissor;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    u64 generation = 0;
+    u32 busy = 0;
+    bool quit = false;
+    std::atomic<u32> next_tile;
+    void worker_main();
+    void run_tiles();
+    void raster_tile(u32 tile);
+    void raster_box(std::vector<u32> const& bin, Box const& box);
+};
+
+#endif // SOFTWARERASTERIZER_H_
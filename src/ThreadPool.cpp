@@ -0,0 +1,90 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+// Index of the calling thread's queue in the pool it works for.
+static thread_local ThreadPool const* current_pool = nullptr;
+static thread_local usize current_queue = 0;
+
+ThreadPool::ThreadPool(u32 threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    for (u32 i = 0; i <= threads; i++) queues.push_back(std::make_unique<Queue>());
+    for (u32 i = 0; i < threads; i++) workers.emplace_back([this, i] { worker_main(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(sleep_mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::run(usize n, void (*fn)(void*, usize), void* ctx) {
+    if (n == 0) return;
+    usize own = current_pool == this ? current_queue : workers.size();
+    if (workers.empty() || n == 1) {
+        for (usize i = 0; i < n; i++) fn(ctx, i);
+        return;
+    }
+    // a few chunks per thread, so stealing can even out uneven items
+    usize chunks = std::min<usize>(n, (workers.size() + 1) * 4);
+    Job job{ fn, ctx, { chunks } };
+    {
+        Queue& q = *queues[own];
+        std::lock_guard lock(q.mutex);
+        for (usize c = chunks; c-- > 0;) q.tasks.push_back({ &job, n * c / chunks, n * (c + 1) / chunks });
+    }
+    pending.fetch_add(chunks);
+    {
+        std::lock_guard lock(sleep_mutex);
+    }
+    wake.notify_all();
+    while (job.remaining.load(std::memory_order_acquire) > 0) {
+        if (!execute_one(own)) std::this_thread::yield();
+    }
+}
+
+bool ThreadPool::execute_one(usize own) {
+    Task task;
+    bool found = false;
+    {
+        Queue& q = *queues[own];
+        std::lock_guard lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (usize k = 1; !found && k < queues.size(); k++) {
+        Queue& q = *queues[(own + k) % queues.size()];
+        std::lock_guard lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+    pending.fetch_sub(1);
+    for (usize i = task.begin; i < task.end; i++) task.job->fn(task.job->ctx, i);
+    task.job->remaining.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void ThreadPool::worker_main(usize index) {
+    current_pool = this;
+    current_queue = index;
+    while (true) {
+        if (execute_one(index)) continue;
+        std::unique_lock lock(sleep_mutex);
+        wake.wait(lock, [this] { return quit || pending.load() > 0; });
+        if (quit) return;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include "defines.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool: every worker owns a deque, takes work from its back and
+// steals from the front of the others' when it runs dry. Threads that wait
+// for a parallel_for execute pending tasks meanwhile, so parallel_for can be
+// nested inside tasks without blocking workers.
+class ThreadPool {
+public:
+    // threads = 0 uses one worker per hardware thread, minus the caller.
+    ThreadPool(u32 threads = 0);
+    ~ThreadPool();
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+    static ThreadPool& global();
+    u32 worker_count() const { return workers.size(); }
+    // Calls f(i) for every i in [0, n) and returns once all calls are done.
+    template<typename F>
+    void parallel_for(usize n, F&& f) {
+        run(n, [](void* ctx, usize i) { (*static_cast<std::remove_reference_t<F>*>(ctx))(i); }, &f);
+    }
+private:
+    struct Job {
+        void (*fn)(void*, usize);
+        void* ctx;
+        std::atomic<usize> remaining;
+    };
+    struct Task {
+        Job* job;
+        usize begin;
+        usize end;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    // one queue per worker, plus a last one for threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<usize> pending{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool quit = false;
+    void run(usize n, void (*fn)(void*, usize), void* ctx);
+    bool execute_one(usize own);
+    void worker_main(usize index);
+};
+
+#endif // THREADPOOL_H_
@@ -3,15 +3,29 @@
 
 #include "RenderContext.hpp"
 #include "BoxConstraints.hpp"
-#include <map>
+#include "PointerRouter.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cstddef>
 #include <memory>
+#include <memory_resource>
 #include <optional>
-#include <string>
 #include <utility>
 #include <vector>
 
 
+// Parent data: small typed values a widget carries for its parent's layout
+// (e.g. the flex factor read by Flex). Keys are fixed slots, so reading one
+// during layout is an array access rather than a string lookup.
 class WidgetProps {
+public:
+    enum Key : u8 {
+        PropFlex,
+        PropFit,
+        PROP_COUNT,
+    };
+private:
     union WidgetPropsTy {
         i8  _i8[8];
         u8  _u8[8];
@@ -25,44 +39,402 @@ class WidgetProps {
         f64 _f64;
         const char* _cstr;
     };
-    std::map<std::string, WidgetPropsTy> map;
-    std::optional<WidgetPropsTy> get_prop(const char* key) const {
-        if (auto it = map.find(key); it != map.end()) return it->second;
+    WidgetPropsTy slots[PROP_COUNT] = {};
+    u32 present = 0;
+    static_assert(PROP_COUNT <= 32);
+    std::optional<WidgetPropsTy> get_prop(Key key) const {
+        if (present & (1u << key)) return slots[key];
         return std::nullopt;
     }
-    void set_prop(const char* key, WidgetPropsTy val) { map.insert(std::make_pair(key, val)); }
+    void set_prop(Key key, WidgetPropsTy val) { slots[key] = val; present |= 1u << key; }
 public:
-    void set(const char* key, i8 value) { WidgetPropsTy v; v._i8[0] = value; set_prop(key, v); }
-    std::optional<i8> get_i8(const char* key) const { if (auto t = get_prop(key)) return t->_i8[0]; return std::nullopt; }
-    void set(const char* key, i16 value) { WidgetPropsTy v; v._i16[0] = value; set_prop(key, v); }
-    std::optional<i16> get_i16(const char* key) const { if (auto t = get_prop(key)) return t->_i16[0]; return std::nullopt; }
-    void set(const char* key, i32 value) { WidgetPropsTy v; v._i32[0] = value; set_prop(key, v); }
-    std::optional<i32> get_i32(const char* key) const { if (auto t = get_prop(key)) return t->_i32[0]; return std::nullopt; }
-    void set(const char* key, i64 value) { WidgetPropsTy v; v._i64 = value; set_prop(key, v); }
-    std::optional<i64> get_i64(const char* key) const { if (auto t = get_prop(key)) return t->_i64; return std::nullopt; }
-    void set(const char* key, u8 value) { WidgetPropsTy v; v._u8[0] = value; set_prop(key, v); }
-    std::optional<u8> get_u8(const char* key) const { if (auto t = get_prop(key)) return t->_u8[0]; return std::nullopt; }
-    void set(const char* key, u16 value) { WidgetPropsTy v; v._u16[0] = value; set_prop(key, v); }
-    std::optional<u16> get_u16(const char* key) const { if (auto t = get_prop(key)) return t->_u16[0]; return std::nullopt; }
-    void set(const char* key, u32 value) { WidgetPropsTy v; v._u32[0] = value; set_prop(key, v); }
-    std::optional<u32> get_u32(const char* key) const { if (auto t = get_prop(key)) return t->_u32[0]; return std::nullopt; }
-    void set(const char* key, u64 value) { WidgetPropsTy v; v._u64 = value; set_prop(key, v); }
-    std::optional<u64> get_u64(const char* key) const { if (auto t = get_prop(key)) return t->_u64; return std::nullopt; }
-    void set(const char* key, f32 value) { WidgetPropsTy v; v._f32[0] = value; set_prop(key, v); }
-    std::optional<f32> get_f32(const char* key) const { if (auto t = get_prop(key)) return t->_f32[0]; return std::nullopt; }
-    void set(const char* key, f64 value) { WidgetPropsTy v; v._f64 = value; set_prop(key, v); }
-    std::optional<f64> get_f64(const char* key) const { if (auto t = get_prop(key)) return t->_f64; return std::nullopt; };
+    void set(Key key, i8 value) { WidgetPropsTy v; v._i8[0] = value; set_prop(key, v); }
+    std::optional<i8> get_i8(Key key) const { if (auto t = get_prop(key)) return t->_i8[0]; return std::nullopt; }
+    void set(Key key, i16 value) { WidgetPropsTy v; v._i16[0] = value; set_prop(key, v); }
+    std::optional<i16> get_i16(Key key) const { if (auto t = get_prop(key)) return t->_i16[0]; return std::nullopt; }
+    void set(Key key, i32 value) { WidgetPropsTy v; v._i32[0] = value; set_prop(key, v); }
+    std::optional<i32> get_i32(Key key) const { if (auto t = get_prop(key)) return t->_i32[0]; return std::nullopt; }
+    void set(Key key, i64 value) { WidgetPropsTy v; v._i64 = value; set_prop(key, v); }
+    std::optional<i64> get_i64(Key key) const { if (auto t = get_prop(key)) return t->_i64; return std::nullopt; }
+    void set(Key key, u8 value) { WidgetPropsTy v; v._u8[0] = value; set_prop(key, v); }
+    std::optional<u8> get_u8(Key key) const { if (auto t = get_prop(key)) return t->_u8[0]; return std::nullopt; }
+    void set(Key key, u16 value) { WidgetPropsTy v; v._u16[0] = value; set_prop(key, v); }
+    std::optional<u16> get_u16(Key key) const { if (auto t = get_prop(key)) return t->_u16[0]; return std::nullopt; }
+    void set(Key key, u32 value) { WidgetPropsTy v; v._u32[0] = value; set_prop(key, v); }
+    std::optional<u32> get_u32(Key key) const { if (auto t = get_prop(key)) return t->_u32[0]; return std::nullopt; }
+    void set(Key key, u64 value) { WidgetPropsTy v; v._u64 = value; set_prop(key, v); }
+    std::optional<u64> get_u64(Key key) const { if (auto t = get_prop(key)) return t->_u64; return std::nullopt; }
+    void set(Key key, f32 value) { WidgetPropsTy v; v._f32[0] = value; set_prop(key, v); }
+    std::optional<f32> get_f32(Key key) const { if (auto t = get_prop(key)) return t->_f32[0]; return std::nullopt; }
+    void set(Key key, f64 value) { WidgetPropsTy v; v._f64 = value; set_prop(key, v); }
+    std::optional<f64> get_f64(Key key) const { if (auto t = get_prop(key)) return t->_f64; return std::nullopt; }
+};
+
+// What a widget lowers to in a FlatTree: one of the layout behaviours the flat
+// engine implements, with its parameters in f/u/c. Opaque widgets stay single
+// nodes laid out and painted through their own virtuals.
+struct FlatNode {
+    enum Kind : u8 {
+        Opaque,
+        Leaf,        // f[0..1]: size, f[2]: corner radius, f[3]: border, c: color
+        Pass,        // lays the child out with its own constraints
+        Align,       // f[0..1]: alignment in [-1, 1], f[2..3]: size factor
+        Constrained, // f[0..3]: constraints enforced on the child
+        Limited,     // f[0..1]: size limit when unbounded
+        Flex,        // u: packed Flex settings
+        List,        // every child gets the same constraints
+        Position,    // f[0..1]: child position, u: absolute
+        Elevate,     // f[0]: z offset, f[1]: shadow corner radius, c: shadow color
+        Clip,        // clips the paint of the subtree to its box
+    };
+    Kind kind = Opaque;
+    f32 f[4] = {};
+    u32 u = 0;
+    Color c = 0u;
 };
 
 class Widget {
+    friend class WidgetArena;
+    friend class PointerRouter;
+    // Set while a WidgetArena builds a tree on this thread.
+    static inline thread_local std::pmr::memory_resource* arena_resource = nullptr;
+    static constexpr usize ALLOC_HEADER = alignof(std::max_align_t);
+    Widget* parent = nullptr;
+    BoxConstraints layout_constraints{};
+    bool needs_layout = true;
+    bool child_needs_layout = false;
+    bool relayout_boundary = false;
+    bool needs_paint = true;
+    bool child_needs_paint = false;
+    bool pointer_target = false;
+    // the slot of this widget in the router indexing it, if any
+    u32 hit_slot = 0;
+    PointerRouter* router = nullptr;
+    // On a root: the dirty relayout and repaint boundaries below it, for
+    // flush_layout and flush_paint. On a boundary: the root whose list holds
+    // it, if any.
+    struct DirtyLists {
+        std::vector<Widget*> layout;
+        std::vector<Widget*> paint;
+    };
+    std::unique_ptr<DirtyLists> dirty_lists;
+    Widget* layout_queued_in = nullptr;
+    Widget* paint_queued_in = nullptr;
+    static void unqueue(std::vector<Widget*>& q, Widget* w) { q.erase(std::find(q.begin(), q.end(), w)); }
+    DirtyLists& lists() {
+        if (!dirty_lists) dirty_lists = std::make_unique<DirtyLists>();
+        return *dirty_lists;
+    }
+    // widgets in this subtree, this one included
+    usize subtree_size = 1;
+    // box around all the subtree paints, relative to its origin
+    Rect paint_bounds = Rect::everything();
 protected:
     Position render_pos;
     Size render_size;
+    void adopt(Widget* c) {
+        if (!c) return;
+        c->parent = this;
+        for (Widget* p = this; p; p = p->parent) p->subtree_size += c->subtree_size;
+        mark_needs_layout();
+        // boundaries queued while c was a root move to the root of this tree
+        if (c->dirty_lists) {
+            DirtyLists queued = std::move(*c->dirty_lists);
+            c->dirty_lists.reset();
+            for (Widget* w : queued.layout) {
+                w->layout_queued_in = nullptr;
+                w->mark_needs_layout();
+            }
+            for (Widget* w : queued.paint) {
+                w->paint_queued_in = nullptr;
+                w->mark_needs_paint();
+            }
+        }
+    }
+    // For children created and dropped during layout (see ListView): only
+    // links them, since adopt would dirty ancestors that are being laid out
+    // and race with siblings laid out in parallel.
+    void attach(Widget* c) { c->parent = this; }
+    // Also drops the subtree from the pointer index until it is attached and
+    // laid out again.
+    static void detach(Widget* c) { c->parent = nullptr; unindex(c); }
+    static void unindex(Widget* w) {
+        if (w->router) w->router->remove(w);
+        for (usize i = 0; i < w->child_count(); i++) {
+            if (auto c = w->child_at(i)) unindex(c);
+        }
+    }
+    // Turns ctx, the context this widget is painted with, into the one its
+    // children are painted with. Hit testing replays it to find where the
+    // children ended up, so render() must place them the same way.
+    virtual void child_context(RenderContext& ctx) const { ctx.pos += render_pos; }
+    // Makes PointerRouter deliver pointer events to on_pointer.
+    void set_pointer_target(bool target) {
+        pointer_target = target;
+        if (!target && router) router->remove(this);
+        // indexed with the next layout
+        if (target) mark_needs_layout();
+    }
+    // What the subtree paints relative to this widget's origin (the context
+    // position plus render_pos), computed after each layout. Widgets that do
+    // not paint relative to that origin must return Rect::everything().
+    virtual Rect compute_paint_bounds() {
+        Rect r = Rect::from_size(render_size);
+        for (usize i = 0; i < child_count(); i++) {
+            if (auto c = child_at(i)) r = r.united(c->paint_bounds.translated(c->render_pos));
+        }
+        return r;
+    }
+    // Where child lists should allocate: the arena being built into, if any.
+    static std::pmr::memory_resource* child_resource() { return arena_resource ? arena_resource : std::pmr::get_default_resource(); }
+    // Calls f(i) for i in [0, n), on the thread pool when the subtrees below
+    // this widget hold at least parallel_layout_threshold widgets. Each call
+    // may only lay out its own child and store the result in its own slot;
+    // the caller merges the results in child order afterwards, so the outcome
+    // does not depend on scheduling.
+    template<typename F>
+    void layout_children(usize n, F&& f) {
+        if (n > 1 && subtree_size - 1 >= parallel_layout_threshold) ThreadPool::global().parallel_for(n, f);
+        else for (usize i = 0; i < n; i++) f(i);
+    }
 public:
+    // Subtree size from which layout_children fans out to the thread pool.
+    static inline usize parallel_layout_threshold = 4096;
     WidgetProps props;
-    virtual ~Widget() = default;
+    // Every widget records the resource it was allocated from in a header in
+    // front of it, so delete returns it to the arena or the heap as needed.
+    static void* operator new(std::size_t size) {
+        std::pmr::memory_resource* r = arena_resource ? arena_resource : std::pmr::new_delete_resource();
+        void* p = r->allocate(size + ALLOC_HEADER, alignof(std::max_align_t));
+        *static_cast<std::pmr::memory_resource**>(p) = r;
+        return static_cast<byte*>(p) + ALLOC_HEADER;
+    }
+    static void operator delete(void* p, std::size_t size) {
+        byte* base = static_cast<byte*>(p) - ALLOC_HEADER;
+        (*reinterpret_cast<std::pmr::memory_resource**>(base))->deallocate(base, size + ALLOC_HEADER, alignof(std::max_align_t));
+    }
+    virtual ~Widget() {
+        if (router) router->remove(this);
+        if (layout_queued_in) unqueue(layout_queued_in->dirty_lists->layout, this);
+        if (paint_queued_in) unqueue(paint_queued_in->dirty_lists->paint, this);
+        if (dirty_lists) {
+            for (Widget* w : dirty_lists->layout) w->layout_queued_in = nullptr;
+            for (Widget* w : dirty_lists->paint) w->paint_queued_in = nullptr;
+        }
+    }
     virtual void render(RenderContext&) {}
+    // Pointer events for targets (see set_pointer_target). Returns whether
+    // the event was handled; Press, Release and Wheel go on to the ancestor
+    // targets until one handles them.
+    virtual bool on_pointer(PointerEvent const&) { return false; }
     virtual Size calculate_layout(BoxConstraints const&) { return {}; }
+    virtual usize child_count() const { return 0; }
+    virtual Widget* child_at(usize) { return nullptr; }
+    // Repaint boundaries keep their drawing in a retained DrawBatch layer and
+    // are the widgets mark_needs_paint stops at.
+    virtual bool is_repaint_boundary() const { return false; }
+    // Re-records the layer of a repaint boundary outside of a full traversal.
+    virtual void repaint_layer() {}
+    // Subclasses that change calculate_layout or render must override this
+    // too, or return an Opaque node.
+    virtual FlatNode lower() const { return {}; }
+    // Entry point parents use to lay out a child: reuses the previous size (and
+    // the positions it gave its children) when the constraints are unchanged and
+    // nothing in the subtree called mark_needs_layout since.
+    Size layout(BoxConstraints const& ctr) {
+        relayout_boundary = ctr.is_tight() || !parent;
+        if (!needs_layout && ctr == layout_constraints) return render_size;
+        PROFILE_WIDGET_ZONE(*this);
+        render_size = calculate_layout(ctr);
+        paint_bounds = compute_paint_bounds();
+        layout_constraints = ctr;
+        needs_layout = false;
+        needs_paint = true;
+        return render_size;
+    }
+    // Entry point parents use to draw a child. Subtrees outside ctx.clip are
+    // skipped and counted in the batch's stats. A skipped repaint boundary
+    // stays dirty, so that it records its layer again once it is in view,
+    // even where it was last recorded.
+    void paint(RenderContext& ctx) {
+        if (!ctx.clip.intersects(paint_bounds.translated(ctx.pos + render_pos))) {
+            if (ctx.b) ctx.b->count_culled(subtree_size);
+            if (!is_repaint_boundary()) {
+                needs_paint = false;
+                child_needs_paint = false;
+            }
+            return;
+        }
+        PROFILE_WIDGET_ZONE(*this);
+        render(ctx);
+        needs_paint = false;
+        child_needs_paint = false;
+    }
+    // Flags this widget and its ancestors up to the nearest relayout boundary
+    // (a widget laid out with tight constraints, whose size therefore cannot
+    // change), and queues the boundary at the root for flush_layout. Ancestors
+    // above the boundary only learn that something below them is dirty.
+    void mark_needs_layout() {
+        Widget* w = this;
+        while (true) {
+            w->needs_layout = true;
+            if (w->relayout_boundary || !w->parent) break;
+            w = w->parent;
+        }
+        Widget* root = w;
+        for (Widget* p = w->parent; p; p = p->parent) {
+            p->child_needs_layout = true;
+            root = p;
+        }
+        if (root != w && w->layout_queued_in != root) {
+            if (w->layout_queued_in) unqueue(w->layout_queued_in->dirty_lists->layout, w);
+            root->lists().layout.push_back(w);
+            w->layout_queued_in = root;
+        }
+        // the boundary relayout can move anything under it, not only this subtree
+        mark_needs_paint();
+        w->mark_needs_paint();
+    }
+    // Flags this widget and its ancestors up to the nearest repaint boundary,
+    // whose layer will be recorded again, and queues the boundary at the root
+    // for flush_paint. Ancestors above it only learn that a layer below them
+    // is dirty.
+    void mark_needs_paint() {
+        Widget* w = this;
+        while (true) {
+            w->needs_paint = true;
+            if (w->is_repaint_boundary() || !w->parent) break;
+            w = w->parent;
+        }
+        Widget* root = w;
+        for (Widget* p = w->parent; p; p = p->parent) {
+            p->child_needs_paint = true;
+            root = p;
+        }
+        if (root != w && w->paint_queued_in != root) {
+            if (w->paint_queued_in) unqueue(w->paint_queued_in->dirty_lists->paint, w);
+            root->lists().paint.push_back(w);
+            w->paint_queued_in = root;
+        }
+    }
+    // Relayouts the dirty relayout boundaries below this widget with the
+    // constraints they last received. They are taken from the root's queue and
+    // laid out directly, parents first, so nothing else is visited. The
+    // boundaries laid out are appended to `relaid`, if given: nothing outside
+    // of them moved.
+    void flush_layout(std::vector<Widget*>* relaid = nullptr) {
+        if (!needs_layout && !child_needs_layout) return;
+        Widget* root = this;
+        while (root->parent) root = root->parent;
+        // with their depth below this widget; kept across calls, so that a
+        // frame allocates nothing
+        static thread_local std::vector<std::pair<usize, Widget*>> scratch;
+        std::vector<std::pair<usize, Widget*>> dirty;
+        dirty.swap(scratch);
+        if (needs_layout) dirty.push_back({ 0, this });
+        if (root->dirty_lists) {
+            auto& queue = root->dirty_lists->layout;
+            usize kept = 0;
+            for (Widget* w : queue) {
+                usize depth = 0;
+                Widget* p = w;
+                for (; p && p != this; p = p->parent) depth++;
+                if (p) {
+                    dirty.push_back({ depth, w });
+                } else if (root != this) {
+                    queue[kept++] = w;
+                    continue;
+                }
+                // below this widget, or no longer in the tree at all
+                w->layout_queued_in = nullptr;
+            }
+            queue.resize(kept);
+        }
+        std::stable_sort(dirty.begin(), dirty.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+        for (auto [depth, w] : dirty) {
+            // laid out along with a boundary above it
+            if (!w->needs_layout) continue;
+            w->layout(w->layout_constraints);
+            if (relaid) relaid->push_back(w);
+            // the parent was not laid out again: grow its bounds instead, which
+            // can only make culling less tight
+            for (Widget* c = w; c->parent; c = c->parent) {
+                Rect r = c->paint_bounds.translated(c->render_pos);
+                if (c->parent->paint_bounds.contains(r)) break;
+                c->parent->paint_bounds = c->parent->paint_bounds.united(r);
+            }
+        }
+        for (auto [depth, w] : dirty) {
+            for (Widget* p = w->parent; depth-- > 0; p = p->parent) p->child_needs_layout = false;
+        }
+        child_needs_layout = false;
+        dirty.clear();
+        scratch.swap(dirty);
+    }
+    // Re-records the dirty repaint boundaries below this widget, leaving every
+    // other layer untouched. They are taken from the root's queue: for each,
+    // the topmost widget flagged on its path is repainted, which records the
+    // boundaries under it again as needed, so nothing else is visited.
+    void flush_paint() {
+        if (!child_needs_paint) return;
+        Widget* root = this;
+        while (root->parent) root = root->parent;
+        // kept across calls, so that a frame allocates nothing
+        static thread_local std::vector<Widget*> scratch;
+        std::vector<Widget*> dirty;
+        dirty.swap(scratch);
+        if (root->dirty_lists) {
+            auto& queue = root->dirty_lists->paint;
+            usize kept = 0;
+            for (Widget* w : queue) {
+                Widget* top = w->needs_paint ? w : nullptr;
+                Widget* p = w->parent;
+                if (w != this) {
+                    for (; p && p != this; p = p->parent) {
+                        if (p->needs_paint) top = p;
+                    }
+                }
+                // under a flagged ancestor: its flush_paint, when that one is
+                // recorded, still has to see it
+                if (p && top && top != w) {
+                    queue[kept++] = w;
+                    dirty.push_back(top);
+                    continue;
+                }
+                if (!p && root != this) {
+                    queue[kept++] = w;
+                    continue;
+                }
+                if (p && top && w != this) dirty.push_back(w);
+                // taken, already painted, or no longer in the tree at all
+                w->paint_queued_in = nullptr;
+            }
+            queue.resize(kept);
+        }
+        for (Widget* w : dirty) {
+            for (Widget* p = w->parent; p != this; p = p->parent) p->child_needs_paint = false;
+        }
+        child_needs_paint = false;
+        for (Widget* w : dirty) {
+            // several queued boundaries may share it
+            if (!w->needs_paint) continue;
+            w->repaint_layer();
+            w->needs_paint = false;
+            w->child_needs_paint = false;
+        }
+        dirty.clear();
+        scratch.swap(dirty);
+    }
+    bool get_needs_layout() const { return needs_layout; }
+    bool get_needs_paint() const { return needs_paint; }
+    // Whether flush_layout or a paint has anything to do in this subtree.
+    bool is_dirty() const { return needs_layout || child_needs_layout || needs_paint || child_needs_paint; }
+    bool is_relayout_boundary() const { return relayout_boundary; }
+    bool is_pointer_target() const { return pointer_target; }
+    usize get_subtree_size() const { return subtree_size; }
+    Rect get_paint_bounds() const { return paint_bounds; }
+    void set_paint_bounds(Rect r) { paint_bounds = r; }
+    Widget* get_parent() { return parent; }
     void set_render_pos(Position pos) { render_pos = pos; }
     Position get_render_pos() { return render_pos; }
     void set_render_size(Size size) { render_size = size; }
@@ -73,42 +445,46 @@ class ChildWidget : public Widget {
 protected:
     std::unique_ptr<Widget> child;
 public:
-    ChildWidget(std::unique_ptr<Widget> &&child) : child(std::move(child)) {}
+    ChildWidget(std::unique_ptr<Widget> &&child) : child(std::move(child)) { adopt(this->child.get()); }
     void render(RenderContext& ctx) override {
         if (!child) return;
         push_rctx_pos(ctx);
-        ctx.pos += render_pos;
-        child->render(ctx);
+        child_context(ctx);
+        child->paint(ctx);
     }
     Size calculate_layout(BoxConstraints const& ctr) override {
-        if (child) return child->calculate_layout(ctr);
+        if (child) return child->layout(ctr);
         return ctr.smallest();
     }
+    usize child_count() const override { return child ? 1 : 0; }
+    Widget* child_at(usize) override { return child.get(); }
+    FlatNode lower() const override { return { FlatNode::Pass }; }
 };
 
 class WidgetList : public Widget {
 protected:
-    std::vector<std::unique_ptr<Widget>> children;
+    std::pmr::vector<std::unique_ptr<Widget>> children{child_resource()};
 public:
     WidgetList() {}
-    WidgetList(std::unique_ptr<Widget> w) { children.push_back(std::move(w)); }
-    WidgetList(Widget* w) : WidgetList(std::unique_ptr<Widget>(w)) {}
     template<typename... Ts>
-    WidgetList(Widget* w, Ts... ws) : WidgetList(ws...) { children.insert(children.begin(), std::unique_ptr<Widget>(w)); }
+    WidgetList(Widget* w, Ts... ws) { children.reserve(1 + sizeof...(ws)); add_child(w); (add_child(std::move(ws)), ...); }
     template<typename... Ts>
-    WidgetList(std::unique_ptr<Widget> w, Ts... ws) : WidgetList(ws...) { children.insert(children.begin(), std::move(w)); }
-    WidgetList(std::vector<std::unique_ptr<Widget>> c) : children(std::move(c)) {}
+    WidgetList(std::unique_ptr<Widget> w, Ts... ws) { children.reserve(1 + sizeof...(ws)); add_child(std::move(w)); (add_child(std::move(ws)), ...); }
+    WidgetList(std::vector<std::unique_ptr<Widget>> c) { children.reserve(c.size()); for (auto &w : c) add_child(std::move(w)); }
     WidgetList& add_child(Widget* c) { add_child(std::unique_ptr<Widget>(c)); return *this; }
-    WidgetList& add_child(std::unique_ptr<Widget> &&c)  { children.push_back(std::move(c)); return *this; }
+    WidgetList& add_child(std::unique_ptr<Widget> &&c)  { adopt(c.get()); children.push_back(std::move(c)); return *this; }
     void render(RenderContext& ctx) override {
         push_rctx_pos(ctx);
         ctx.pos += render_pos;
-        for (auto &c : children) c->render(ctx);
+        for (auto &c : children) c->paint(ctx);
     }
     Size calculate_layout(BoxConstraints const& ctr) override {
-        for (auto &c : children) c->calculate_layout(ctr);
+        layout_children(children.size(), [&](usize i) { children[i]->layout(ctr); });
         return ctr.smallest();
     }
+    usize child_count() const override { return children.size(); }
+    Widget* child_at(usize i) override { return children[i].get(); }
+    FlatNode lower() const override { return { FlatNode::List }; }
 };
 
 template<typename T, typename ...Ts>
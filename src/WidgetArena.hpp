@@ -0,0 +1,36 @@
+#ifndef WIDGETARENA_H_
+#define WIDGETARENA_H_
+
+#include "Widget.hpp"
+#include <memory_resource>
+#include <utility>
+
+// Bump allocator for whole widget trees. Widgets created inside build(), with
+// wi<T> or new as usual, and the child lists of Flex and WidgetList, are laid
+// out contiguously in the arena instead of coming from malloc:
+//
+//   WidgetArena arena;
+//   std::unique_ptr<Widget> root(arena.build([] { return wi<Row>(...); }));
+//
+// Deleting an arena widget runs its destructor but gives no memory back; all
+// of it is released at once when the arena is destroyed, so the tree must be
+// destroyed first. Children added after build() still come from the heap,
+// except for the growth of child lists created inside it.
+class WidgetArena {
+    std::pmr::monotonic_buffer_resource resource;
+public:
+    WidgetArena(usize initial_size = 64 * 1024) : resource(initial_size) {}
+    WidgetArena(WidgetArena const&) = delete;
+    WidgetArena& operator=(WidgetArena const&) = delete;
+    template<typename F>
+    auto build(F&& f) {
+        struct Scope {
+            std::pmr::memory_resource* prev;
+            Scope(std::pmr::memory_resource* r) : prev(Widget::arena_resource) { Widget::arena_resource = r; }
+            ~Scope() { Widget::arena_resource = prev; }
+        } scope(&resource);
+        return std::forward<F>(f)();
+    }
+};
+
+#endif // WIDGETARENA_H_
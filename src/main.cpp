@@ -4,12 +4,18 @@
 #include <cmath>
 #include <cstdio>
 #include <memory>
+#include <string>
+#include <string_view>
 #include "widgets/Align.hpp"
 #include "widgets/Blob.hpp"
+#include "widgets/Button.hpp"
 #include "widgets/Constrained.hpp"
 #include "widgets/Flex.hpp"
 #include "widgets/Position.hpp"
+#include "widgets/Static.hpp"
+#include "widgets/Text.hpp"
 #include "App.hpp"
+#include "Markup.hpp"
 
 /*
  * <Widget "CustomWidget">
@@ -38,34 +44,61 @@
  *       <Widget "CustomWidget" />
  *     </Column>
  *   </Align>
- *   <PositionBox 140 40 absolute><Elevate 10><Blob 200x200 0xff88ffff /></Elevate></PositionBox>
+ *   <PositionBox 140 40 absolute><Elevate 10 radius=16><Blob 200x200 0xff88ffff radius=16 /></Elevate></PositionBox>
+ *   <PositionBox 152 52 absolute><Elevate 11 shadow=0x00000000><Text "uilib 0.1" size=28 weight=bold /></Elevate></PositionBox>
  * </App>
  */
 
-class CustomWidget : public ConstrainedBox {
-public:
-    CustomWidget() : ConstrainedBox(BoxConstraints { 150, INFINITY, 0, INFINITY }, wi<Row>(
-          wi<Blob>(40, 40, 0xff0000ff),
-          wi<ConstrainedBox>(BoxConstraints::tight_h(40), wi<Column>(
-              wi<Blob>(100, 15, 0xff0000ff),
-              wi<Blob>(90, 15, 0xff0000ff)
-          )->set_main_axis_alignment(Flex::MainAxisSpaceAround))
-      )->set_main_axis_size(Flex::MainAxisMin)->set_main_axis_alignment(Flex::MainAxisSpaceBetween)) {}
-};
+// Fixed at compile time: one widget to the dynamic tree, inlined inside.
+using CustomWidget = Static<StaticConstrained<BoxConstraints{150, INFINITY, 0, INFINITY},
+    StaticFlex<Axis::Horizontal, StaticFlexOptions{Flex::MainAxisMin, Flex::MainAxisSpaceBetween},
+        StaticBlob<40, 40, 0xff0000ff>,
+        StaticConstrained<BoxConstraints{0, INFINITY, 40, 40},
+            StaticFlex<Axis::Vertical, StaticFlexOptions{.main_axis_alignment = Flex::MainAxisSpaceAround},
+                StaticBlob<100, 15, 0xff0000ff>,
+                StaticBlob<90, 15, 0xff0000ff>>>>>>;
 
-int main() {
-    App("Cpp UI Prototype", {800.f, 600.f}, wi<WidgetList>(
-        wi<Align>(Align::BottomRight, wi<Column>(
-             wi<Expanded>(wi<Blob>(300, 20, 0xff0000ff))->flex(2),
-             wi<Expanded>(wi<Blob>(140, 30, 0x00ff00ff))->flex(1),
-             wi<Blob>(500, 50, 0x0000ffff),
-             wi<Blob>(400, 100, 0xffff00ff),
-             wi<Blob>(250, 20, 0x00ffffff),
-             //wi<Button>(200, 50)->on_press([](){printf("pressed\n");}),
-             wi<Blob>(200, 50, 0x000000ff),
-             wi<CustomWidget>()
-        )->set_main_axis_size(Flex::MainAxisMin)),
-        wi<PositionBox>(140, 40, wi<Elevate>(10, new Blob({200.0, 200.0}, 0xff88ffff)))->absolute()
-    )).run();
+int main(int argc, char** argv) {
+    // --headless out.ppm renders one frame on the CPU and saves it;
+    // --screen file.ui (or a compiled .uib) replaces the built-in tree
+    const char* headless = nullptr;
+    const char* screen = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (std::string_view(argv[i]) == "--headless") headless = argv[i + 1];
+        else if (std::string_view(argv[i]) == "--screen") screen = argv[i + 1];
+    }
+    std::unique_ptr<Widget> root;
+    if (screen) {
+        std::string error;
+        root = load_screen(screen, WidgetRegistry::builtin(), &error);
+        if (!root) {
+            fprintf(stderr, "%s: %s\n", screen, error.c_str());
+            return 1;
+        }
+    } else {
+        root.reset(wi<WidgetList>(
+            wi<Align>(Align::BottomRight, wi<Column>(
+                 wi<Expanded>(wi<Blob>(300, 20, 0xff0000ff))->flex(2),
+                 wi<Expanded>(wi<Blob>(140, 30, 0x00ff00ff))->flex(1),
+                 wi<Blob>(500, 50, 0x0000ffff),
+                 wi<Blob>(400, 100, 0xffff00ff),
+                 wi<Blob>(250, 20, 0x00ffffff),
+                 wi<Button>(200, 50)->on_press([](){printf("pressed\n");}),
+                 wi<Blob>(200, 50, 0x000000ff),
+                 wi<CustomWidget>()
+            )->set_main_axis_size(Flex::MainAxisMin)),
+            wi<PositionBox>(140, 40, wi<Elevate>(10, (new Blob({200.0, 200.0}, 0xff88ffff))->set_radius(16))->set_radius(16))->absolute(),
+            // raised above the box it sits on
+            wi<PositionBox>(152, 52, wi<Elevate>(11, wi<Text>("uilib 0.1", Font{28, true}))->set_shadow(0x00000000u))->absolute()
+        ));
+    }
+    App app("Cpp UI Prototype", {800.f, 600.f}, std::move(root), headless ? DrawBatch::Software : DrawBatch::OpenGL);
+    // the demo is static: only redraw when something asks for it
+    app.set_render_mode(App::OnDemand);
+    app.run();
+    if (headless && !app.save_frame(headless)) {
+        fprintf(stderr, "Could not write %s\n", headless);
+        return 1;
+    }
     return 0;
 }
@@ -120,6 +120,7 @@ struct Color {
     u8 r, g, b, a;
     Color(u8 r, u8 g, u8 b, u8 a) : r(r), g(g), b(b), a(a) {}
     Color(u32 hex) : r((hex >> 24) & 0xff), g((hex >> 16) & 0xff), b((hex >> 8) & 0xff), a((hex >> 0) & 0xff) {}
+    bool operator==(Color const&) const = default;
 };
 
 enum class Axis {
@@ -137,6 +138,23 @@ enum class VerticalDirection {
     Down,
 };
 
+// Axis-aligned box from (x0, y0) inclusive to (x1, y1) exclusive.
+struct Rect {
+    f32 x0 = 0.f, y0 = 0.f, x1 = 0.f, y1 = 0.f;
+    static Rect everything() { return { -INFINITY, -INFINITY, INFINITY, INFINITY }; }
+    static Rect from_size(Size s) { return { 0.f, 0.f, s.w, s.h }; }
+    static Rect from_pos_size(Position p, Size s) { return { p.x, p.y, p.x + s.w, p.y + s.h }; }
+    Rect translated(Position p) const { return { x0 + p.x, y0 + p.y, x1 + p.x, y1 + p.y }; }
+    Rect united(Rect const& o) const { return { std::fmin(x0, o.x0), std::fmin(y0, o.y0), std::fmax(x1, o.x1), std::fmax(y1, o.y1) }; }
+    // Empty when the boxes do not overlap.
+    Rect intersected(Rect const& o) const { return { std::fmax(x0, o.x0), std::fmax(y0, o.y0), std::fmin(x1, o.x1), std::fmin(y1, o.y1) }; }
+    bool empty() const { return !(x0 < x1 && y0 < y1); }
+    bool contains(Position p) const { return x0 <= p.x && p.x < x1 && y0 <= p.y && p.y < y1; }
+    bool intersects(Rect const& o) const { return x0 < o.x1 && o.x0 < x1 && y0 < o.y1 && o.y0 < y1; }
+    bool contains(Rect const& o) const { return x0 <= o.x0 && y0 <= o.y0 && o.x1 <= x1 && o.y1 <= y1; }
+    bool operator==(Rect const&) const = default;
+};
+
 struct Insets {
     f32 top;
     f32 bottom;
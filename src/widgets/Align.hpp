@@ -21,6 +21,7 @@ public:
 private:
     Alignment alignment; // TODO: handle Value alignment
     Size factor = {1, 1};
+public:
     static Position get_align_pos(Alignment a) {
         switch (a) {
         case TopLeft: return {-1.0, -1.0};
@@ -35,21 +36,24 @@ private:
         default: return {0, 0};
         }
     }
-public:
     Align(Alignment a, std::unique_ptr<Widget> &&child) : ChildWidget(std::move(child)), alignment(a) {}
     Align(Alignment a, Widget* child) : Align(a, std::unique_ptr<Widget>(child)) {}
-    Align& with_width_factor(f32 wf) { factor.w = wf; return *this; }
-    Align& with_height_factor(f32 hf) { factor.h = hf; return *this; }
-    Align& with_factor(f32 wf, f32 hf) { factor = {wf, hf}; return *this; }
-    Align& with_factor(Size f) { factor = f; return *this; }
+    Align& with_width_factor(f32 wf) { factor.w = wf; mark_needs_layout(); return *this; }
+    Align& with_height_factor(f32 hf) { factor.h = hf; mark_needs_layout(); return *this; }
+    Align& with_factor(f32 wf, f32 hf) { factor = {wf, hf}; mark_needs_layout(); return *this; }
+    Align& with_factor(Size f) { factor = f; mark_needs_layout(); return *this; }
     Size calculate_layout(BoxConstraints const& ctr) override {
         Position p = get_align_pos(alignment);
-        Size wanted_size = child->calculate_layout(ctr.loosen());
+        Size wanted_size = child->layout(ctr.loosen());
         Size size = ctr.constrain(wanted_size * factor);
         p = (size - wanted_size) * (p + Position{1.0, 1.0}) / 2.0;
         child->set_render_pos(p);
         return size;
     }
+    FlatNode lower() const override {
+        Position p = get_align_pos(alignment);
+        return { FlatNode::Align, { p.x, p.y, factor.w, factor.h } };
+    }
 };
 
 class Center : public Align {
@@ -3,9 +3,12 @@
 
 #include "../Widget.hpp"
 
+// A box of one color, optionally with rounded corners or only a border.
 class Blob : public Widget {
     Size size;
     Color color;
+    f32 radius = 0.f;
+    f32 border = 0.f;
 public:
     Blob(f32 w, f32 h, Color c) : size(w, h), color(c) {}
     Blob(Size s, Color c) : size(s), color(c) {}
@@ -15,10 +18,16 @@ public:
     }
     void render(RenderContext& context) override {
         Position pos = context.pos + render_pos;
-        context.draw_rectangle(pos.x, pos.y, render_size.w, render_size.h, color, context.z);
+        if (radius > 0.f || border > 0.f) context.draw_border(pos.x, pos.y, render_size.w, render_size.h, radius, border, color, context.z);
+        else context.draw_rectangle(pos.x, pos.y, render_size.w, render_size.h, color, context.z);
     }
-    Blob* set_size(Size s) { size = s; return this; }
-    Blob* set_color(Color c) { color = c; return this; }
+    FlatNode lower() const override { return { FlatNode::Leaf, { size.w, size.h, radius, border }, 0, color }; }
+    Blob* set_size(Size s) { size = s; mark_needs_layout(); return this; }
+    Blob* set_color(Color c) { color = c; mark_needs_paint(); return this; }
+    // Half the smaller side or more makes a pill or a circle.
+    Blob* set_radius(f32 r) { radius = r; mark_needs_paint(); return this; }
+    // Draws only a border this wide; 0 fills the box.
+    Blob* set_border(f32 w) { border = w; mark_needs_paint(); return this; }
 };
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef BUTTON_H_
+#define BUTTON_H_
+
+#include "../Widget.hpp"
+#include <functional>
+#include <memory>
+
+// Box that changes color while hovered and held, and calls the on_press
+// callback when the left button is released over it. Without a child it
+// takes the given size.
+class Button : public ChildWidget {
+    Size size;
+    Color color = 0xd0d0d0ff;
+    Color hover_color = 0xb8b8b8ff;
+    Color pressed_color = 0x909090ff;
+    bool hovered = false;
+    bool pressed = false;
+    std::function<void()> pressed_fn;
+public:
+    Button(f32 w, f32 h) : ChildWidget(nullptr), size(w, h) { set_pointer_target(true); }
+    Button(std::unique_ptr<Widget> &&child) : ChildWidget(std::move(child)) { set_pointer_target(true); }
+    Button(Widget* child) : Button(std::unique_ptr<Widget>(child)) {}
+    Button* on_press(std::function<void()> f) { pressed_fn = std::move(f); return this; }
+    Button* set_colors(Color normal, Color hover, Color held) {
+        color = normal, hover_color = hover, pressed_color = held;
+        mark_needs_paint();
+        return this;
+    }
+    bool is_hovered() const { return hovered; }
+    bool is_pressed() const { return pressed; }
+    Size calculate_layout(BoxConstraints const& ctr) override {
+        if (child) return child->layout(ctr);
+        return ctr.constrain(size);
+    }
+    // The child sits just above the background, so that its edges blend with it.
+    void child_context(RenderContext& ctx) const override { ctx.pos += render_pos; ctx.z += 0.01f; }
+    void render(RenderContext& ctx) override {
+        Position pos = ctx.pos + render_pos;
+        ctx.draw_rectangle(pos.x, pos.y, render_size.w, render_size.h, pressed ? pressed_color : hovered ? hover_color : color, ctx.z);
+        ChildWidget::render(ctx);
+    }
+    FlatNode lower() const override { return {}; }
+    bool on_pointer(PointerEvent const& e) override {
+        switch (e.type) {
+        case PointerEvent::Enter:
+        case PointerEvent::Leave:
+            hovered = e.type == PointerEvent::Enter;
+            mark_needs_paint();
+            return true;
+        case PointerEvent::Press:
+            if (e.button != PointerEvent::Left) return false;
+            pressed = true;
+            mark_needs_paint();
+            return true;
+        case PointerEvent::Release:
+            if (!pressed) return false;
+            pressed = false;
+            mark_needs_paint();
+            if (hovered && pressed_fn) pressed_fn();
+            return true;
+        default:
+            return false;
+        }
+    }
+};
+
+#endif // BUTTON_H_
@@ -0,0 +1,23 @@
+#ifndef CLIPRECT_H_
+#define CLIPRECT_H_
+
+#include "../Widget.hpp"
+#include <memory>
+
+// Clips what its subtree paints, and where it can be hit, to its own box: a
+// child that overflows (e.g. a Row with too many children) is cut off at its
+// edge. Each primitive carries the clip rect into the batch, so nested clips
+// add no draw calls, and subtrees outside of it are not painted at all.
+class ClipRect : public ChildWidget {
+public:
+    ClipRect(std::unique_ptr<Widget> &&child) : ChildWidget(std::move(child)) {}
+    ClipRect(Widget* child) : ClipRect(std::unique_ptr<Widget>(child)) {}
+    void child_context(RenderContext &ctx) const override {
+        ctx.pos += render_pos;
+        ctx.clip_to(Rect::from_pos_size(ctx.pos, render_size));
+    }
+    Rect compute_paint_bounds() override { return Rect::from_size(render_size); }
+    FlatNode lower() const override { return { FlatNode::Clip }; }
+};
+
+#endif // CLIPRECT_H_
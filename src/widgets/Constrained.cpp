@@ -2,7 +2,7 @@
 
 Size LimitedBox::compute_size(BoxConstraints const& ctr) {
     auto cns = limit_constraints(ctr);
-    if (child) return ctr.constrain(child->calculate_layout(cns));
+    if (child) return ctr.constrain(child->layout(cns));
     return cns.constrain(Size{});
 }
 
@@ -11,9 +11,12 @@ public:
     ConstrainedBox(BoxConstraints const& c, std::unique_ptr<Widget>&& child) : ChildWidget(std::move(child)), constraints(c) {}
     ConstrainedBox(BoxConstraints const& c, Widget* w = nullptr) : ConstrainedBox(c, std::unique_ptr<Widget>(w)) {}
     Size calculate_layout(BoxConstraints const& ctr) override {
-        if (child) return child->calculate_layout(constraints.enforce(ctr));
+        if (child) return child->layout(constraints.enforce(ctr));
         return constraints.enforce(ctr).constrain(Size{});
     }
+    FlatNode lower() const override {
+        return { FlatNode::Constrained, { constraints.min_width, constraints.max_width, constraints.min_height, constraints.max_height } };
+    }
 };
 
 class LimitedBox : public ChildWidget {
@@ -28,6 +31,7 @@ public:
     Size calculate_layout(BoxConstraints const& ctr) override {
         return compute_size(ctr);
     }
+    FlatNode lower() const override { return { FlatNode::Limited, { max_size.w, max_size.h } }; }
 };
 
 class SizedBox : public ConstrainedBox {
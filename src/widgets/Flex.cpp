@@ -18,7 +18,7 @@ void Flex::render(RenderContext& context) {
     push_rctx_pos(context);
     context.pos += render_pos;
     for (auto& c : children) {
-        c->render(context);
+        c->paint(context);
     }
 }
 
@@ -46,51 +46,62 @@ void Flex::position_children(std::vector<Size> const& sizes, f32 main_size, f32
     }
 }
 
+// Children are laid out through layout_children, possibly in parallel; sizes
+// are summed in child order afterwards, so the result matches a serial pass.
 std::tuple<Size, std::vector<Size>> Flex::compute_sizes(BoxConstraints const& constraints) {
     f32 total_flex = 0;
     f32 max_main_size = (direction == Axis::Horizontal) ? constraints.max_width : constraints.max_height;
     bool can_flex = max_main_size < INFINITY;
     f32 cross_size = 0.f;
     f32 allocated_size = 0.f;
-    std::vector<Size> sizes;
-    sizes.reserve(children.size());
+    std::vector<Size> sizes(children.size());
     i32 last_flex_child_id = -1;
-    for (i32 i = 0; auto &c : children) {
-        i32 flex = c->props.get_i32("flex").value_or(0);
-        if (flex > 0) {
-            sizes.push_back({0, 0});
+    auto flex_of = [&](usize i) { return children[i]->props.get_i32(WidgetProps::PropFlex).value_or(0); };
+    auto add_size = [&](Size child_size) {
+        Size mc_size = (direction == Axis::Horizontal) ? child_size : Size{child_size.h, child_size.w};
+        allocated_size += mc_size.w;
+        cross_size = std::max(cross_size, mc_size.h);
+        return mc_size;
+    };
+    for (usize i = 0; i < children.size(); i++) {
+        if (i32 flex = flex_of(i); flex > 0) {
             total_flex += flex;
             last_flex_child_id = i;
-        } else {
-            BoxConstraints inner_constraints;
-            if (cross_axis_alignment == CrossAxisStretch) {
-                inner_constraints = (direction == Axis::Horizontal) ?
-                    BoxConstraints::tight_h(constraints.max_height) :
-                    BoxConstraints::tight_w(constraints.max_width);
-            } else {
-                inner_constraints = (direction == Axis::Horizontal) ?
-                    BoxConstraints { 0.0, INFINITY, 0.0, constraints.max_height } :
-                    BoxConstraints { 0.0, constraints.max_width, 0.0, INFINITY };
-            }
-            Size child_size = c->calculate_layout(inner_constraints);
-            sizes.push_back(child_size);
-            Size mc_size = (direction == Axis::Horizontal) ? child_size : Size{child_size.h, child_size.w};
-            allocated_size += mc_size.w;
-            cross_size = std::max(cross_size, mc_size.h);
         }
-        i++;
     }
-    f32 free_space = std::max(0.f, (can_flex ? max_main_size : 0.f) - allocated_size);
-    f32 allocated_flex_space = 0.f;
-    f32 space_per_flex = (can_flex && total_flex > 0) ? free_space / total_flex : NAN;
-    for (i32 i = 0; auto &c : children) {
-        i32 flex = c->props.get_i32("flex").value_or(0);
-        if (flex > 0) {
-            f32 max_child_extent = INFINITY;
-            if (can_flex) {
-                max_child_extent = (i == last_flex_child_id) ? free_space - allocated_flex_space : space_per_flex * flex;
-            }
-            f32 min_child_extent = (c->props.get_i32("fit").value_or(FitTight) == FitTight) ? max_child_extent : 0.f;
+    BoxConstraints inner_constraints;
+    if (cross_axis_alignment == CrossAxisStretch) {
+        inner_constraints = (direction == Axis::Horizontal) ?
+            BoxConstraints::tight_h(constraints.max_height) :
+            BoxConstraints::tight_w(constraints.max_width);
+    } else {
+        inner_constraints = (direction == Axis::Horizontal) ?
+            BoxConstraints { 0.0, INFINITY, 0.0, constraints.max_height } :
+            BoxConstraints { 0.0, constraints.max_width, 0.0, INFINITY };
+    }
+    layout_children(children.size(), [&](usize i) {
+        if (flex_of(i) <= 0) sizes[i] = children[i]->layout(inner_constraints);
+    });
+    for (usize i = 0; i < children.size(); i++) {
+        if (flex_of(i) <= 0) add_size(sizes[i]);
+    }
+    if (last_flex_child_id >= 0) {
+        f32 free_space = std::max(0.f, (can_flex ? max_main_size : 0.f) - allocated_size);
+        f32 space_per_flex = (can_flex && total_flex > 0) ? free_space / total_flex : NAN;
+        // the last flex child takes whatever rounding left over
+        f32 allocated_flex_space = 0.f;
+        for (i32 i = 0; i < last_flex_child_id; i++) {
+            if (i32 flex = flex_of(i); flex > 0) allocated_flex_space += space_per_flex * flex;
+        }
+        auto max_extent = [&](usize i) {
+            if (!can_flex) return f32(INFINITY);
+            return (i32(i) == last_flex_child_id) ? free_space - allocated_flex_space : space_per_flex * flex_of(i);
+        };
+        layout_children(children.size(), [&](usize i) {
+            if (flex_of(i) <= 0) return;
+            auto &c = children[i];
+            f32 max_child_extent = max_extent(i);
+            f32 min_child_extent = (c->props.get_i32(WidgetProps::PropFit).value_or(FitTight) == FitTight) ? max_child_extent : 0.f;
             BoxConstraints inner_constraints;
             if (cross_axis_alignment == CrossAxisStretch) {
                 inner_constraints = (direction == Axis::Horizontal) ?
@@ -101,17 +112,32 @@ std::tuple<Size, std::vector<Size>> Flex::compute_sizes(BoxConstraints const& co
                     BoxConstraints{min_child_extent, max_child_extent, 0.0, constraints.max_height } :
                     BoxConstraints{ 0.0, constraints.max_width, min_child_extent, max_child_extent };
             }
-            Size child_size = c->calculate_layout(inner_constraints);
-            sizes[i] = child_size;
-            Size mc_size = (direction == Axis::Horizontal) ? child_size : Size{child_size.h, child_size.w};
-            assert(mc_size.w <= max_child_extent);
-            allocated_size += mc_size.w;
-            allocated_flex_space += max_child_extent;
-            cross_size = std::max(cross_size, mc_size.h);
+            sizes[i] = c->layout(inner_constraints);
+        });
+        for (usize i = 0; i < children.size(); i++) {
+            if (flex_of(i) <= 0) continue;
+            [[maybe_unused]] Size mc_size = add_size(sizes[i]);
+            assert(mc_size.w <= max_extent(i));
         }
-        i++;
     }
     f32 ideal_size = (can_flex && main_axis_size == MainAxisMax) ? max_main_size : allocated_size;
     Size out_size = (direction == Axis::Horizontal) ? Size{ideal_size, cross_size} : Size{cross_size, ideal_size};
     return std::tie(out_size, sizes);
 }
+
+FlatNode Flex::lower() const {
+    u32 u = u32(direction) | u32(main_axis_alignment) << 1 | u32(main_axis_size) << 4 | u32(cross_axis_alignment) << 5
+        | u32(text_direction) << 8 | u32(vertical_direction) << 9;
+    return { FlatNode::Flex, {}, u };
+}
+
+Flex::Packed Flex::unpack(u32 u) {
+    return {
+        Axis(u & 1),
+        MainAxisAlignment((u >> 1) & 7),
+        MainAxisSize((u >> 4) & 1),
+        CrossAxisAlignment((u >> 5) & 7),
+        TextDirection((u >> 8) & 1),
+        VerticalDirection((u >> 9) & 1),
+    };
+}
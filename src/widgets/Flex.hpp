@@ -56,14 +56,27 @@ public:
     void render(RenderContext& context) override;
     Size calculate_layout(BoxConstraints const& constraints) override;
     static std::unique_ptr<Flex> make();
-    Flex* set_direction(Axis a) { direction = a; return this; }
-    Flex* set_main_axis_alignment(MainAxisAlignment maa) { main_axis_alignment = maa; return this; }
-    Flex* set_main_axis_size(MainAxisSize mas) { main_axis_size = mas; return this; }
-    Flex* set_cross_axis_alignment(CrossAxisAlignment caa) { cross_axis_alignment = caa; return this; }
-    Flex* set_text_direction(TextDirection td) { text_direction = td; return this; }
-    Flex* set_vertical_direction(VerticalDirection vd) { vertical_direction = vd; return this; }
-    Flex* add_child(std::unique_ptr<Widget>&& c) { children.push_back(std::move(c)); return this; }
-    Flex* add_child(Widget* c) { children.push_back(std::unique_ptr<Widget>(c)); return this; }
+    Flex* set_direction(Axis a) { direction = a; mark_needs_layout(); return this; }
+    Flex* set_main_axis_alignment(MainAxisAlignment maa) { main_axis_alignment = maa; mark_needs_layout(); return this; }
+    Flex* set_main_axis_size(MainAxisSize mas) { main_axis_size = mas; mark_needs_layout(); return this; }
+    Flex* set_cross_axis_alignment(CrossAxisAlignment caa) { cross_axis_alignment = caa; mark_needs_layout(); return this; }
+    Flex* set_text_direction(TextDirection td) { text_direction = td; mark_needs_layout(); return this; }
+    Flex* set_vertical_direction(VerticalDirection vd) { vertical_direction = vd; mark_needs_layout(); return this; }
+    Flex* add_child(std::unique_ptr<Widget>&& c) { adopt(c.get()); children.push_back(std::move(c)); return this; }
+    Flex* add_child(Widget* c) { adopt(c); children.push_back(std::unique_ptr<Widget>(c)); return this; }
+    usize child_count() const override { return children.size(); }
+    Widget* child_at(usize i) override { return children[i].get(); }
+    FlatNode lower() const override;
+    // Settings packed into FlatNode::u by lower().
+    struct Packed {
+        Axis direction;
+        MainAxisAlignment main_axis_alignment;
+        MainAxisSize main_axis_size;
+        CrossAxisAlignment cross_axis_alignment;
+        TextDirection text_direction;
+        VerticalDirection vertical_direction;
+    };
+    static Packed unpack(u32 u);
 private:
     Axis direction;
     MainAxisAlignment main_axis_alignment = MainAxisStart;
@@ -73,7 +86,7 @@ private:
     VerticalDirection vertical_direction = VerticalDirection::Down;
     // text_baseline: Option<()>,
     // clip_behavior: Option<()>,
-    std::vector<std::unique_ptr<Widget>> children;
+    std::pmr::vector<std::unique_ptr<Widget>> children{child_resource()};
     bool can_compute_intrinsics() const { return cross_axis_alignment != CrossAxisBaseline; }
     void position_children(std::vector<Size> const& sizes, f32 main_size, f32 cross_size);
     std::tuple<Size, std::vector<Size>> compute_sizes(BoxConstraints const& constraints);
@@ -81,12 +94,10 @@ private:
     friend class Row;
 public:
     Flex(Axis axis) : direction(axis) {}
-    Flex(Axis axis, std::unique_ptr<Widget> w) : direction(axis) { children.push_back(std::move(w)); }
-    Flex(Axis axis, Widget* w) : Flex(axis, std::unique_ptr<Widget>(w)) {}
     template<typename... Ts>
-    Flex(Axis axis, Widget* w, Ts... ws) : Flex(axis, ws...) { children.insert(children.begin(), std::unique_ptr<Widget>(w)); }
+    Flex(Axis axis, Widget* w, Ts... ws) : direction(axis) { children.reserve(1 + sizeof...(ws)); add_child(w); (add_child(std::move(ws)), ...); }
     template<typename... Ts>
-    Flex(Axis axis, std::unique_ptr<Widget> w, Ts... ws) : Flex(axis, ws...) { children.insert(children.begin(), std::move(w)); }
+    Flex(Axis axis, std::unique_ptr<Widget> w, Ts... ws) : direction(axis) { children.reserve(1 + sizeof...(ws)); add_child(std::move(w)); (add_child(std::move(ws)), ...); }
 };
 
 class Column : public Flex {
@@ -102,9 +113,15 @@ public:
 
 class Flexible : public ChildWidget {
 public:
-    Flexible(std::unique_ptr<Widget> &&child, Flex::FlexFit fit = Flex::FitLoose) : ChildWidget(std::move(child)) { props.set("fit", i32(fit)); }
+    Flexible(std::unique_ptr<Widget> &&child, Flex::FlexFit fit = Flex::FitLoose) : ChildWidget(std::move(child)) { props.set(WidgetProps::PropFit, i32(fit)); }
     Flexible(Widget* child, Flex::FlexFit fit = Flex::FitLoose) : Flexible(std::unique_ptr<Widget>(child), fit) {}
-    Flexible* flex(i32 f) { props.set("flex", f); return this; }
+    Flexible* flex(i32 f) {
+        props.set(WidgetProps::PropFlex, f);
+        // the flex factor is read by the parent, so it must relayout even if this widget is a relayout boundary
+        if (auto p = get_parent()) p->mark_needs_layout();
+        mark_needs_layout();
+        return this;
+    }
 };
 
 class Expanded : public Flexible {
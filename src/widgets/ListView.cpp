@@ -0,0 +1,115 @@
+#include "ListView.hpp"
+#include <algorithm>
+#include <cmath>
+
+Size ListView::calculate_layout(BoxConstraints const& constraints) {
+    bool horizontal = direction == Axis::Horizontal;
+    f32 max_main = horizontal ? constraints.max_width : constraints.max_height;
+    f32 max_cross = horizontal ? constraints.max_height : constraints.max_width;
+    f64 extent = std::max(item_estimate(), 1.0);
+    f64 content = extent * item_count;
+    viewport = max_main < INFINITY ? max_main : f32(content);
+    scroll_offset = std::clamp(scroll_offset, 0.0, std::max(0.0, content - viewport));
+    BoxConstraints item_constraints = max_cross < INFINITY ?
+        (horizontal ? BoxConstraints::tight_h(max_cross) : BoxConstraints::tight_w(max_cross)) :
+        BoxConstraints::no_constraints();
+    f64 lo = scroll_offset - overscan;
+    f64 hi = scroll_offset + viewport + overscan;
+
+    // items far outside the new range can be reused right away
+    std::deque<Item>& old = previous;
+    std::swap(old, items);
+    items.clear();
+    for (auto& it : old) {
+        f64 guess = it.index * extent;
+        if (guess + extent < lo - viewport || guess > hi + viewport) recycle(std::move(it.widget));
+    }
+    f32 cross_size = 0.f;
+    auto place = [&](usize index) {
+        Item it{ index, nullptr, 0.0, 0.f };
+        bool fresh = true;
+        if (!old.empty() && index >= old.front().index && index - old.front().index < old.size()) {
+            auto& prev = old[index - old.front().index].widget;
+            fresh = !prev;
+            it.widget = std::move(prev);
+        }
+        if (fresh) {
+            std::unique_ptr<Widget> recycled;
+            if (!pool.empty()) {
+                recycled = std::move(pool.back());
+                pool.pop_back();
+            }
+            it.widget = builder(index, std::move(recycled));
+            attach(it.widget.get());
+        }
+        Size s = it.widget->layout(item_constraints);
+        it.extent = horizontal ? s.w : s.h;
+        cross_size = std::max(cross_size, horizontal ? s.h : s.w);
+        if (fresh && item_extent <= 0.f) {
+            measured_total += it.extent;
+            measured_count++;
+        }
+        return it;
+    };
+    // walks up from the first item until the range start is covered
+    auto fill_backward = [&](f64 start) {
+        usize i = items.empty() ? item_count : items.front().index;
+        while (i > 0 && start > lo) {
+            Item it = place(--i);
+            start -= it.extent;
+            it.offset = start;
+            items.push_front(std::move(it));
+        }
+    };
+    bool at_end = content > viewport && scroll_offset >= content - viewport;
+    if (item_count && at_end) {
+        // the end stays reachable even when items are larger than estimated
+        fill_backward(scroll_offset + viewport);
+    } else if (item_count) {
+        usize i = std::min<usize>(item_count - 1, std::max(0.0, lo) / extent);
+        f64 pos = i * extent;
+        for (; i < item_count && pos < hi; i++) {
+            Item it = place(i);
+            it.offset = pos;
+            pos += it.extent;
+            items.push_back(std::move(it));
+        }
+        // items smaller than estimated: align the last one with the end
+        f64 gap = scroll_offset + viewport - pos;
+        if (i == item_count && gap > 0.0 && content > viewport) {
+            for (auto& it : items) it.offset += gap;
+            fill_backward(items.front().offset);
+        }
+    }
+    for (auto& it : old) {
+        if (it.widget) recycle(std::move(it.widget));
+    }
+    old.clear();
+    while (pool.size() > items.size()) pool.pop_back();
+    for (auto& it : items) {
+        f32 main = f32(it.offset - scroll_offset);
+        it.widget->set_render_pos(horizontal ? Position{ main, 0.f } : Position{ 0.f, main });
+    }
+    if (max_cross < INFINITY) cross_size = max_cross;
+    return constraints.constrain(horizontal ? Size{ viewport, cross_size } : Size{ cross_size, viewport });
+}
+
+void ListView::render(RenderContext& context) {
+    push_rctx_pos(context);
+    child_context(context);
+    // overscan items are built and laid out, but only visible ones are drawn
+    for (auto& it : items) {
+        f32 main = f32(it.offset - scroll_offset);
+        if (main + it.extent <= 0.f || main >= viewport) continue;
+        it.widget->paint(context);
+    }
+}
+
+bool ListView::on_pointer(PointerEvent const& e) {
+    if (e.type != PointerEvent::Wheel) return false;
+    f32 delta = direction == Axis::Horizontal && e.scroll.x != 0.f ? e.scroll.x : e.scroll.y;
+    f64 offset = std::clamp<f64>(scroll_offset + delta, 0.0, get_max_scroll_offset());
+    if (offset == scroll_offset) return false;
+    set_scroll_offset(offset);
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef LISTVIEW_H_
+#define LISTVIEW_H_
+
+#include "../Widget.hpp"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Scrolling list of item_count items built on demand. Only the items that
+// overlap the viewport, plus `overscan` pixels on either side, exist at any
+// time; items scrolled out go to a pool and are handed back to the builder for
+// reuse. Item positions come from a fixed item extent when one is set, else
+// from the mean extent of the items measured so far. The list stays lazy only
+// under bounded main-axis constraints. It scrolls with the mouse wheel, and
+// hands the wheel on to the targets above it once it hits either end. Offsets
+// into the content are f64, which keeps them exact to the pixel over many
+// millions of items; only positions within the viewport are f32.
+class ListView : public Widget {
+public:
+    // Returns the widget for item `index`. `recycled` is the widget of an item
+    // that left the viewport, or null; the builder may update and return it
+    // instead of allocating a new one. Runs during layout, which may be on a
+    // thread pool worker when siblings of the list are laid out in parallel.
+    using Builder = std::function<std::unique_ptr<Widget>(usize index, std::unique_ptr<Widget> recycled)>;
+    ListView(usize item_count, Builder builder, Axis direction = Axis::Vertical)
+        : item_count(item_count), builder(std::move(builder)), direction(direction) { set_pointer_target(true); }
+    // Drops the built items, e.g. after the data behind them changed.
+    ListView* refresh() { release_all(); mark_needs_layout(); return this; }
+    ListView* set_item_count(usize n) { item_count = n; return refresh(); }
+    // Exact extent of every item along the main axis; 0 measures them instead.
+    ListView* set_item_extent(f32 e) { item_extent = e; mark_needs_layout(); return this; }
+    // Extent assumed for items before any has been measured.
+    ListView* set_estimated_extent(f32 e) { estimated_extent = e; mark_needs_layout(); return this; }
+    ListView* set_overscan(f32 px) { overscan = px; mark_needs_layout(); return this; }
+    // Clamped to [0, get_max_scroll_offset()] by the next layout.
+    ListView* set_scroll_offset(f64 offset) { scroll_offset = offset; mark_needs_layout(); return this; }
+    ListView* scroll_by(f64 delta) { return set_scroll_offset(scroll_offset + delta); }
+    f64 get_scroll_offset() const { return scroll_offset; }
+    f64 get_max_scroll_offset() const { return std::max(0.0, get_content_extent() - viewport); }
+    f64 get_content_extent() const { return item_count * item_estimate(); }
+    usize get_item_count() const { return item_count; }
+    usize get_pool_size() const { return pool.size(); }
+    // Index of the first built item; the others follow in order.
+    usize get_first_index() const { return items.empty() ? 0 : items.front().index; }
+    Size calculate_layout(BoxConstraints const& constraints) override;
+    void render(RenderContext& context) override;
+    bool on_pointer(PointerEvent const& e) override;
+    usize child_count() const override { return items.size(); }
+    Widget* child_at(usize i) override { return items[i].widget.get(); }
+protected:
+    // items are only drawn, and hit, inside the viewport
+    void child_context(RenderContext& ctx) const override {
+        ctx.pos += render_pos;
+        ctx.clip_to(Rect::from_pos_size(ctx.pos, render_size));
+    }
+    Rect compute_paint_bounds() override { return Rect::from_size(render_size); }
+private:
+    struct Item {
+        usize index;
+        std::unique_ptr<Widget> widget;
+        f64 offset; // along the main axis, from the start of the content
+        f32 extent;
+    };
+    usize item_count;
+    Builder builder;
+    Axis direction;
+    f32 item_extent = 0.f;
+    f32 estimated_extent = 32.f;
+    f32 overscan = 64.f;
+    f64 scroll_offset = 0.0;
+    f32 viewport = 0.f;
+    f64 measured_total = 0.0;
+    u64 measured_count = 0;
+    std::deque<Item> items;
+    std::deque<Item> previous; // the last layout's items, while laying out
+    std::vector<std::unique_ptr<Widget>> pool;
+    f64 item_estimate() const {
+        if (item_extent > 0.f) return item_extent;
+        return measured_count ? measured_total / measured_count : estimated_extent;
+    }
+    void recycle(std::unique_ptr<Widget> w) { detach(w.get()); pool.push_back(std::move(w)); }
+    void release_all() {
+        for (auto& it : items) recycle(std::move(it.widget));
+        items.clear();
+    }
+};
+
+#endif // LISTVIEW_H_
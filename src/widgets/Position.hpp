@@ -3,6 +3,7 @@
 
 #include "../Widget.hpp"
 
+#include <algorithm>
 #include <memory>
 class PositionBox : public Widget {
 private:
@@ -10,36 +11,70 @@ private:
     Position pos;
     bool _absolute = false;
 public:
-    PositionBox(Position p, std::unique_ptr<Widget> &&child) : child(std::move(child)), pos(p) {}
+    PositionBox(Position p, std::unique_ptr<Widget> &&child) : child(std::move(child)), pos(p) { adopt(this->child.get()); }
     PositionBox(f32 x, f32 y, std::unique_ptr<Widget> &&child) : PositionBox({x, y}, std::move(child)) {}
     PositionBox(Position p, Widget* child) : PositionBox(p, std::unique_ptr<Widget>(child)) {}
     PositionBox(f32 x, f32 y, Widget* child) : PositionBox({x, y}, child) {}
-    PositionBox* absolute() { _absolute = true; return this; }
+    PositionBox* absolute() { _absolute = true; mark_needs_layout(); return this; }
     Size calculate_layout(const BoxConstraints&) override {
-        child->calculate_layout(BoxConstraints::no_constraints());
+        child->layout(BoxConstraints::no_constraints());
         child->set_render_pos(pos);
         return Size{};
     }
+    usize child_count() const override { return 1; }
+    Widget* child_at(usize) override { return child.get(); }
+    FlatNode lower() const override { return { FlatNode::Position, { pos.x, pos.y }, _absolute }; }
+    // the child is placed relative to the window, not to this widget
+    Rect compute_paint_bounds() override { return Rect::everything(); }
+    void child_context(RenderContext &ctx) const override { ctx.pos = _absolute ? Position{} : render_pos; }
     void render(RenderContext &ctx) override {
         push_rctx_pos(ctx);
-        auto this_pos = _absolute ? Position{} : render_pos;
-        ctx.pos = this_pos;
-        child->render(ctx);
+        child_context(ctx);
+        child->paint(ctx);
     }
 };
 
+// Raises the child by z and casts its shadow on what lies below: the higher
+// it is, the softer the shadow and the further down it falls. The shadow is
+// drawn first, just above what it falls on, so that it blends with it.
 class Elevate : public ChildWidget {
 private:
     f32 z;
+    f32 radius = 0.f;
+    Color shadow = 0x00000050u;
 public:
     Elevate(f32 z, std::unique_ptr<Widget> &&child) : ChildWidget(std::move(child)), z(z) {}
     Elevate(f32 z, Widget *child) : Elevate(z, std::unique_ptr<Widget>(child)) {}
-    void render(RenderContext &ctx) override {
-        push_rctx_pos(ctx);
+    // Corners of the shadow, to match a rounded child.
+    Elevate* set_radius(f32 r) { radius = r; mark_needs_paint(); return this; }
+    // A transparent color casts no shadow. Whether there is one changes the
+    // paint bounds, which are computed with the layout.
+    Elevate* set_shadow(Color c) { shadow = c; mark_needs_layout(); return this; }
+    static f32 shadow_blur(f32 z) { return std::max(z, 0.f); }
+    // The box the shadow of a child of size s covers, relative to the child.
+    static Rect shadow_bounds(Size s, f32 z) {
+        f32 blur = shadow_blur(z);
+        return { -blur, z / 2 - blur, s.w + blur, s.h + z / 2 + blur };
+    }
+    // Just above the surface it falls on, so that it stays below everything
+    // raised less than the child.
+    static void paint_shadow(RenderContext& ctx, Position p, Size s, f32 z, f32 radius, Color c) {
+        if (c.a == 0 || z <= 0.f) return;
+        ctx.draw_shadow(p.x, p.y + z / 2, s.w, s.h, radius, shadow_blur(z), c, ctx.z + z * 0.01f);
+    }
+    void child_context(RenderContext &ctx) const override {
         ctx.pos += render_pos;
         ctx.z += z;
-        child->render(ctx);
     }
+    void render(RenderContext &ctx) override {
+        paint_shadow(ctx, ctx.pos + render_pos, render_size, z, radius, shadow);
+        ChildWidget::render(ctx);
+    }
+    Rect compute_paint_bounds() override {
+        Rect r = ChildWidget::compute_paint_bounds();
+        return shadow.a == 0 ? r : r.united(shadow_bounds(render_size, z));
+    }
+    FlatNode lower() const override { return { FlatNode::Elevate, { z, radius }, 0, shadow }; }
 };
 
 #endif // POSITION_H_
@@ -0,0 +1,54 @@
+#ifndef REPAINTBOUNDARY_H_
+#define REPAINTBOUNDARY_H_
+
+#include "../Widget.hpp"
+#include <memory>
+
+// Records its subtree into a retained DrawBatch layer. While nothing below it
+// calls mark_needs_paint and it does not move, drawing it only costs the
+// reference to its layer.
+class RepaintBoundary : public ChildWidget {
+    DrawBatch* batch = nullptr;
+    DrawBatch::Layer layer = 0;
+    RenderContext painted_ctx;
+    // a paint without a batch cleared dirty flags the layer did not see
+    bool stale = false;
+    void record() {
+        stale = false;
+        batch->begin_layer(layer);
+        RenderContext ctx = painted_ctx;
+        if (child) child->paint(ctx);
+        batch->end_layer();
+    }
+public:
+    RepaintBoundary(std::unique_ptr<Widget> &&child) : ChildWidget(std::move(child)) {}
+    RepaintBoundary(Widget* child) : RepaintBoundary(std::unique_ptr<Widget>(child)) {}
+    ~RepaintBoundary() { if (batch) batch->destroy_layer(layer); }
+    bool is_repaint_boundary() const override { return true; }
+    FlatNode lower() const override { return {}; }
+    void repaint_layer() override { if (batch) record(); }
+    void render(RenderContext& ctx) override {
+        if (!ctx.b) {
+            stale = stale || is_dirty();
+            ChildWidget::render(ctx);
+            return;
+        }
+        bool fresh = batch != ctx.b;
+        if (fresh) {
+            if (batch) batch->destroy_layer(layer);
+            batch = ctx.b;
+            layer = batch->create_layer();
+        }
+        Position origin = ctx.pos + render_pos;
+        if (fresh || stale || get_needs_paint() || origin != painted_ctx.pos || ctx.z != painted_ctx.z || ctx.clip != painted_ctx.clip) {
+            painted_ctx = ctx;
+            painted_ctx.pos = origin;
+            record();
+        } else {
+            flush_paint();
+        }
+        batch->draw_layer(layer);
+    }
+};
+
+#endif // REPAINTBOUNDARY_H_
@@ -0,0 +1,117 @@
+#ifndef STATIC_H_
+#define STATIC_H_
+
+#include "../Widget.hpp"
+#include "Align.hpp"
+#include "Flex.hpp"
+#include <tuple>
+
+// Compile-time composition for subtrees that never change shape: the node
+// types and their settings are template arguments, children live in a
+// std::tuple inside their parent, and layout and render are plain inline
+// member functions expanded with fold expressions. A whole subtree costs one
+// allocation and one virtual call per pass once wrapped in Static<Node>,
+// which puts it in the dynamic tree as a leaf:
+//
+//   wi<Static<StaticConstrained<BoxConstraints{150, INFINITY, 0, INFINITY},
+//       StaticRow<StaticBlob<40, 40, 0xff0000ff>, StaticBlob<90, 15, 0x00ff00ff>>>>>()
+//
+// Nodes lay out like their dynamic counterparts. Every node keeps its size
+// and its offset from its parent.
+struct StaticNode {
+    Size size;
+    Position pos;
+};
+
+// W and H may be integers or floats.
+template<auto W, auto H, u32 C>
+struct StaticBlob : StaticNode {
+    Size layout(BoxConstraints const& ctr) { return size = ctr.constrain(f32(W), f32(H)); }
+    void render(RenderContext& ctx, Position origin) const {
+        Position p = origin + pos;
+        ctx.draw_rectangle(p.x, p.y, size.w, size.h, Color(C), ctx.z);
+    }
+};
+
+template<BoxConstraints C, typename Child>
+struct StaticConstrained : StaticNode {
+    Child child;
+    Size layout(BoxConstraints const& ctr) { return size = child.layout(C.enforce(ctr)); }
+    void render(RenderContext& ctx, Position origin) const { child.render(ctx, origin + pos); }
+};
+
+template<Align::Alignment A, typename Child>
+struct StaticAlign : StaticNode {
+    Child child;
+    Size layout(BoxConstraints const& ctr) {
+        Size wanted = child.layout(ctr.loosen());
+        size = ctr.constrain(wanted);
+        child.pos = (size - wanted) * (Align::get_align_pos(A) + Position{1.0, 1.0}) / 2.0;
+        return size;
+    }
+    void render(RenderContext& ctx, Position origin) const { child.render(ctx, origin + pos); }
+};
+
+// Flex settings of a StaticFlex; children never flex and directions are
+// left to right and top down.
+struct StaticFlexOptions {
+    Flex::MainAxisSize main_axis_size = Flex::MainAxisMax;
+    Flex::MainAxisAlignment main_axis_alignment = Flex::MainAxisStart;
+    Flex::CrossAxisAlignment cross_axis_alignment = Flex::CrossAxisCenter;
+};
+
+template<Axis D, StaticFlexOptions O, typename... Children>
+struct StaticFlex : StaticNode {
+    static_assert(O.cross_axis_alignment != Flex::CrossAxisBaseline, "baseline alignment is not implemented");
+    std::tuple<Children...> children;
+    static Size main_cross(Size s) { return D == Axis::Horizontal ? s : Size{s.h, s.w}; }
+    Size layout(BoxConstraints const& ctr) {
+        BoxConstraints inner;
+        if constexpr (O.cross_axis_alignment == Flex::CrossAxisStretch) {
+            inner = D == Axis::Horizontal ? BoxConstraints::tight_h(ctr.max_height) : BoxConstraints::tight_w(ctr.max_width);
+        } else {
+            inner = D == Axis::Horizontal ? BoxConstraints{0.0, INFINITY, 0.0, ctr.max_height} : BoxConstraints{0.0, ctr.max_width, 0.0, INFINITY};
+        }
+        f32 allocated = 0.f, cross = 0.f;
+        auto measure = [&](auto& c) {
+            Size mc = main_cross(c.layout(inner));
+            allocated += mc.w;
+            cross = std::max(cross, mc.h);
+        };
+        std::apply([&](auto&... c) { (measure(c), ...); }, children);
+        f32 max_main = main_cross({ctr.max_width, ctr.max_height}).w;
+        f32 ideal = (max_main < INFINITY && O.main_axis_size == Flex::MainAxisMax) ? max_main : allocated;
+        size = ctr.constrain(main_cross({ideal, cross}));
+        Size mc = main_cross(size);
+        auto [before, between, _] = Flex::distribute_free_space(O.main_axis_alignment, mc.w - allocated, sizeof...(Children));
+        f32 at = before;
+        bool first = true;
+        auto place = [&](auto& c) {
+            Size cs = main_cross(c.size);
+            if (!first) at += between;
+            first = false;
+            c.pos = main_cross({at, Flex::get_cross_offset(O.cross_axis_alignment, mc.h, cs.h)});
+            at += cs.w;
+        };
+        std::apply([&](auto&... c) { (place(c), ...); }, children);
+        return size;
+    }
+    void render(RenderContext& ctx, Position origin) const {
+        std::apply([&](auto const&... c) { (c.render(ctx, origin + pos), ...); }, children);
+    }
+};
+
+template<typename... Children> using StaticRow = StaticFlex<Axis::Horizontal, StaticFlexOptions{}, Children...>;
+template<typename... Children> using StaticColumn = StaticFlex<Axis::Vertical, StaticFlexOptions{}, Children...>;
+
+// A static subtree as a leaf of the widget tree.
+template<typename Node>
+class Static : public Widget {
+    Node node;
+public:
+    Size calculate_layout(BoxConstraints const& ctr) override { return node.layout(ctr); }
+    void render(RenderContext& ctx) override { node.render(ctx, ctx.pos + render_pos); }
+    Node const& root() const { return node; }
+};
+
+#endif // STATIC_H_
@@ -0,0 +1,53 @@
+#ifndef TEXT_H_
+#define TEXT_H_
+
+#include "../Widget.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+// A single line of text, as wide as its run and one line high. Labels that
+// get the same text back skip shaping through the run cache, and a new text
+// of the same width only repaints. Glyph edges blend with what was drawn
+// before them, so parents paint their background first and raise the text
+// above it.
+class Text : public Widget {
+    std::string text;
+    Font font;
+    Color color;
+    std::shared_ptr<TextRun const> run;
+    void reshape() {
+        Size old = run ? run->size : Size(-1, -1);
+        run = shape_text(text, font);
+        if (run->size == old) mark_needs_paint();
+        else mark_needs_layout();
+    }
+public:
+    Text(std::string_view text, Font font = {}, Color color = 0x000000ffu) : text(text), font(font), color(color) { reshape(); }
+    Text(std::string_view text, f32 size, Color color = 0x000000ffu) : Text(text, Font{ size }, color) {}
+    Size calculate_layout(BoxConstraints const& ctr) override { return ctr.constrain(run->size); }
+    // glyph edges may reach a pixel past the line box
+    Rect compute_paint_bounds() override { return { -1.f, -1.f, run->size.w + 1.f, run->size.h + 1.f }; }
+    void render(RenderContext& ctx) override {
+        Position pos = ctx.pos + render_pos;
+        ctx.draw_text(*run, pos.x, pos.y, color, ctx.z);
+    }
+    FlatNode lower() const override { return {}; }
+    Text* set_text(std::string_view t) {
+        if (t == text) return this;
+        text = t;
+        reshape();
+        return this;
+    }
+    Text* set_font(Font f) {
+        if (f == font) return this;
+        font = f;
+        reshape();
+        return this;
+    }
+    Text* set_color(Color c) { color = c; mark_needs_paint(); return this; }
+    std::string_view get_text() const { return text; }
+    TextRun const& get_run() const { return *run; }
+};
+
+#endif // TEXT_H_
@@ -0,0 +1,37 @@
+// Compiles a markup screen into the binary image load_screen maps and
+// instantiates without parsing.
+//
+//   uilib_markupc screen.ui screen.uib
+
+#include "Markup.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s input.ui output.uib\n", argv[0]);
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        fprintf(stderr, "%s: cannot read the file\n", argv[1]);
+        return 1;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    std::string s = text.str();
+    MarkupDocument doc;
+    std::string error;
+    if (!parse_markup(s, doc, &error)) {
+        fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+    std::vector<u8> image = compile_markup(doc);
+    std::ofstream out(argv[2], std::ios::binary);
+    if (!out.write(reinterpret_cast<const char*>(image.data()), image.size())) {
+        fprintf(stderr, "%s: cannot write the file\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}